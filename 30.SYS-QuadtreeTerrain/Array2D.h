@@ -0,0 +1,120 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility template class
+//
+//  A runtime-sized 2D array stored in a single contiguous,
+//  cache-line aligned block of memory. Elements are laid out
+//  row by row so that array[x][z] works like a built-in
+//  2D array (x is the row, z is the column)
+//
+//	##########################################################
+
+#ifndef ARRAY2D_H
+#define ARRAY2D_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <new>
+#ifdef WIN32
+#include <malloc.h>	// _aligned_malloc, _aligned_free
+#endif
+
+#define ARRAY2D_ALIGNMENT 64	// align rows to the cache line size
+
+template <class T>
+class Array2D
+{
+private:
+	T *data;				// contiguous block of width*length elements
+	int dWidth;			// number of rows (x)
+	int dLength;		// number of columns (z)
+
+	// an Array2D owns its memory, copying is not allowed
+	Array2D(const Array2D &);
+	Array2D &operator=(const Array2D &);
+
+public:
+	Array2D(): data(NULL), dWidth(0), dLength(0) {}
+
+	Array2D(int width, int length): data(NULL), dWidth(0), dLength(0)
+	{
+		allocate(width, length);
+	}
+
+	~Array2D() { release(); }
+
+	// allocate (or reallocate) width*length elements, default constructed
+	void allocate(int width, int length)
+	{
+		release();
+
+		size_t count = (size_t)width * (size_t)length;
+		if (count == 0) return;
+
+		void *block = NULL;
+#ifdef WIN32
+		block = _aligned_malloc(sizeof(T) * count, ARRAY2D_ALIGNMENT);
+#else
+		if (posix_memalign(&block, ARRAY2D_ALIGNMENT, sizeof(T) * count) != 0)
+			block = NULL;
+#endif
+		if (block == NULL) throw std::bad_alloc();
+
+		data = (T*)block;
+		for (size_t i = 0; i < count; i++)
+			new (&data[i]) T();
+
+		dWidth = width;
+		dLength = length;
+	}
+
+	// destroy the elements and free the block
+	void release()
+	{
+		if (data == NULL) return;
+
+		size_t count = size();
+		for (size_t i = 0; i < count; i++)
+			data[i].~T();
+
+#ifdef WIN32
+		_aligned_free(data);
+#else
+		free(data);
+#endif
+		data = NULL;
+		dWidth = dLength = 0;
+	}
+
+	// exchange the contents of two arrays (no copy)
+	void swap(Array2D &other)
+	{
+		T *otherData = other.data;
+		int otherWidth = other.dWidth;
+		int otherLength = other.dLength;
+
+		other.data = data;
+		other.dWidth = dWidth;
+		other.dLength = dLength;
+
+		data = otherData;
+		dWidth = otherWidth;
+		dLength = otherLength;
+	}
+
+	// row access, array[x][z]
+	T *operator[](int x) { return data + (size_t)x * dLength; }
+	const T *operator[](int x) const { return data + (size_t)x * dLength; }
+
+	T *getData() { return data; }
+	const T *getData() const { return data; }
+
+	int getWidth() const { return dWidth; }
+	int getLength() const { return dLength; }
+	size_t size() const { return (size_t)dWidth * (size_t)dLength; }
+	size_t bytes() const { return sizeof(T) * size(); }
+};
+
+#endif
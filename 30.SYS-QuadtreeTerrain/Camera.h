@@ -26,6 +26,7 @@ private:
 	float 	speed, maxSpeed;
 	float 	rotAngle, pitchAngle;
 	bool 		isForward, isBackward, isRight, isLeft, isMoving;
+	float 	fovY, aspect, zNear, zFar;	// the perspective of setViewport (gluPerspective)
 
 public:
 	// Matrix4x4 worldMatrix;
@@ -59,6 +60,11 @@ public:
 	void mousePitch(int value);
 	void mouseYaw(int value);
 
+	// the projection set up with gluPerspective, and the projection times the view of
+	// gluLookAt(x, y, z, tx, ty, tz, 0, 1, 0) as 16 column-major floats (for culling)
+	void setPerspective(float _fovY, float _aspect, float _zNear, float _zFar);
+	void getViewProjection(float *m);
+
 };
 
 #endif
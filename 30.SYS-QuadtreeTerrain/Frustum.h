@@ -0,0 +1,64 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility header
+//
+//  The six planes of a view frustum taken from a view-projection
+//  matrix (column-major, as OpenGL keeps it), and a test of an
+//  axis-aligned box against them. A box is outside when all of
+//  its corners are behind one plane; boxes crossing a corner of
+//  the frustum may be kept, which is safe for culling
+//
+//	##########################################################
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+// a plane is a*x + b*y + c*z + d, positive inside the frustum
+struct FRUSTUMPLANE
+{
+	float a, b, c, d;
+};
+
+// left, right, bottom, top, near, far
+struct FRUSTUM
+{
+	FRUSTUMPLANE planes[6];
+};
+
+// the planes of clip = viewProjection * point: -w <= x, y, z <= w
+inline void extractFrustum(const float *m, FRUSTUM &frustum)
+{
+	for(int i=0; i<3; i++)
+	{
+		for(int side=0; side<2; side++)
+		{
+			float sign = (side == 0) ? 1.0f : -1.0f;
+			FRUSTUMPLANE &p = frustum.planes[i*2 + side];
+			p.a = m[3] + sign * m[i];
+			p.b = m[7] + sign * m[4 + i];
+			p.c = m[11] + sign * m[8 + i];
+			p.d = m[15] + sign * m[12 + i];
+		}
+	}
+}
+
+// true when the box [min, max] is entirely outside the frustum
+inline bool boxOutsideFrustum(const FRUSTUM &frustum, const float *boxMin, const float *boxMax)
+{
+	for(int i=0; i<6; i++)
+	{
+		const FRUSTUMPLANE &p = frustum.planes[i];
+
+		// the corner of the box farthest along the plane normal
+		float x = (p.a >= 0.0f) ? boxMax[0] : boxMin[0];
+		float y = (p.b >= 0.0f) ? boxMax[1] : boxMin[1];
+		float z = (p.c >= 0.0f) ? boxMax[2] : boxMin[2];
+		if (p.a * x + p.b * y + p.c * z + p.d < 0.0f)
+			return true;
+	}
+	return false;
+}
+
+#endif
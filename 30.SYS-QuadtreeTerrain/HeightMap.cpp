@@ -0,0 +1,546 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ Heightmap Class
+//
+//  The source of the terrain elevation samples: 'HeightMap.h'
+//
+//  A heightmap header is a text file next to the heightmap with
+//  the same name and a .hdr extension (terr512.raw -> terr512.hdr)
+//  holding one 'key value' pair per line:
+//
+//    format    raw8 | raw16le | raw16be | float32 | pgm
+//    width     number of samples along x (rows)
+//    length    number of samples along z (columns)
+//    spacing   distance between samples in OpenGL units
+//    vscale    world height of a sample of 1.0
+//
+//  PGM files can carry the same keys in their comment lines
+//  (# spacing 15). A PGM row is a row of x, its columns are z
+//
+//  .tiles files (see TileCache.h) describe themselves
+//
+//	##########################################################
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include "HeightMap.h"
+#include "TerrainNoise.h"
+
+using namespace std;
+
+static bool isLittleEndianHost()
+{
+	uint16_t value = 1;
+	return *(uint8_t*)&value == 1;
+}
+
+static uint16_t swapBytes16(uint16_t value)
+{
+	return (uint16_t)((value >> 8) | (value << 8));
+}
+
+// the number of bytes each sample takes in a RAW file
+static int bytesPerSample(int format)
+{
+	if ((format == HEIGHTMAP_RAW16_LE) || (format == HEIGHTMAP_RAW16_BE)) return 2;
+	if (format == HEIGHTMAP_FLOAT32) return 4;
+	return 1;
+}
+
+// apply a 'key value' pair from a header file or PGM comment
+static void applyHeaderKey(const char *key, const char *value, HEIGHTMAPINFO &info)
+{
+	if (strcmp(key, "format") == 0)
+	{
+		if (strcmp(value, "raw8") == 0) info.format = HEIGHTMAP_RAW8;
+		else if (strcmp(value, "raw16le") == 0) info.format = HEIGHTMAP_RAW16_LE;
+		else if (strcmp(value, "raw16be") == 0) info.format = HEIGHTMAP_RAW16_BE;
+		else if (strcmp(value, "float32") == 0) info.format = HEIGHTMAP_FLOAT32;
+		else if (strcmp(value, "pgm") == 0) info.format = HEIGHTMAP_PGM;
+		else cout<<">> HeightMap: unknown format '"<<value<<"'"<<endl;
+	}
+	else if (strcmp(key, "width") == 0) info.width = atoi(value);
+	else if (strcmp(key, "length") == 0) info.length = atoi(value);
+	else if (strcmp(key, "spacing") == 0) info.cellSpacing = (float)atof(value);
+	else if (strcmp(key, "vscale") == 0) info.verticalScale = (float)atof(value);
+}
+
+// parse the PGM header (magic, width, height, maxval), returning where the samples start
+// the comment lines may carry header keys
+static bool parsePGMHeader(const unsigned char *data, size_t size, bool &binary,
+													int &cols, int &rows, int &maxval, size_t &dataOffset, HEIGHTMAPINFO *info)
+{
+	if ((size < 2) || (data[0] != 'P') || ((data[1] != '5') && (data[1] != '2')))
+		return false;
+
+	binary = (data[1] == '5');
+	int values[3];
+	size_t i = 2;
+
+	for (int v = 0; v < 3; v++)
+	{
+		// skip white space and comments
+		while (i < size)
+		{
+			if (isspace(data[i])) { i++; continue; }
+			if (data[i] != '#') break;
+
+			// a comment runs to the end of the line
+			char line[256];
+			size_t n = 0;
+			for (i++; (i < size) && (data[i] != '\n'); i++)
+				if (n < sizeof(line) - 1) line[n++] = data[i];
+			line[n] = 0;
+
+			char key[64], value[64];
+			if ((info != NULL) && (sscanf(line, "%63s %63s", key, value) == 2))
+				applyHeaderKey(key, value, *info);
+		}
+
+		if ((i >= size) || !isdigit(data[i])) return false;
+
+		values[v] = 0;
+		while ((i < size) && isdigit(data[i]))
+			values[v] = values[v] * 10 + (data[i++] - '0');
+	}
+
+	cols = values[0];
+	rows = values[1];
+	maxval = values[2];
+	dataOffset = i + 1;		// a single white space follows maxval
+
+	return (cols > 0) && (rows > 0) && (maxval > 0) && (maxval < 65536) && (dataOffset <= size);
+}
+
+HeightMap::HeightMap()
+{
+	tiles = NULL;
+	samples8 = NULL;
+	samples16 = NULL;
+	rangeScale = 1.0f / 255.0f;
+	dWidth = dLength = 0;
+}
+
+HeightMap::~HeightMap()
+{
+	release();
+}
+
+bool HeightMap::readHeader(const char *filename, HEIGHTMAPINFO &info)
+{
+	// defaults: the format comes from the file extension
+	info.format = HEIGHTMAP_RAW8;
+	info.width = info.length = 0;
+	info.cellSpacing = 1.0f;
+	info.verticalScale = 1.0f;
+
+	const char *ext = strrchr(filename, '.');
+	if (ext != NULL)
+	{
+		if (strcmp(ext, ".r16") == 0) info.format = HEIGHTMAP_RAW16_LE;
+		else if (strcmp(ext, ".f32") == 0) info.format = HEIGHTMAP_FLOAT32;
+		else if (strcmp(ext, ".pgm") == 0) info.format = HEIGHTMAP_PGM;
+		else if (strcmp(ext, ".tiles") == 0) info.format = HEIGHTMAP_TILED;
+	}
+
+	// tile files carry everything in their binary header
+	if (info.format == HEIGHTMAP_TILED)
+	{
+		TILEFILEHEADER tileHeader;
+		if (!TileCache::readHeader(filename, tileHeader))
+			return false;
+
+		info.width = tileHeader.width;
+		info.length = tileHeader.length;
+		info.cellSpacing = tileHeader.cellSpacing;
+		info.verticalScale = tileHeader.verticalScale;
+		cout<<">> HeightMap: "<<info.width<<"x"<<info.length<<" tiled"
+				<<" spacing:"<<info.cellSpacing<<" vscale:"<<info.verticalScale<<endl;
+		return true;
+	}
+
+	// PGM files carry their own size (and possibly the other keys in comments)
+	if (info.format == HEIGHTMAP_PGM)
+	{
+		MappedFile pgm;
+		bool binary;
+		int cols, rows, maxval;
+		size_t offset;
+
+		if (pgm.open(filename) && parsePGMHeader(pgm.getData(), pgm.getSize(), binary, cols, rows, maxval, offset, &info))
+		{
+			info.width = rows;
+			info.length = cols;
+		}
+	}
+
+	// the header file next to the heightmap overrides everything else
+	string headerName(filename);
+	size_t dot = headerName.find_last_of('.');
+	size_t slash = headerName.find_last_of("/\\");
+	if ((dot != string::npos) && ((slash == string::npos) || (dot > slash)))
+		headerName.erase(dot);
+	headerName += ".hdr";
+
+	FILE *headerFile = fopen(headerName.c_str(), "r");
+	if (headerFile != NULL)
+	{
+		cout<<">> HeightMap: reading header "<<headerName<<endl;
+
+		char line[256];
+		while (fgets(line, sizeof(line), headerFile) != NULL)
+		{
+			char key[64], value[64];
+			if ((line[0] != '#') && (sscanf(line, "%63s %63s", key, value) == 2))
+				applyHeaderKey(key, value, info);
+		}
+		fclose(headerFile);
+	}
+
+	// a headerless square RAW file can be sized from its length
+	if ((info.width <= 0) && (info.format != HEIGHTMAP_PGM))
+	{
+		MappedFile raw;
+		if (raw.open(filename))
+		{
+			int side = (int)(sqrt((double)(raw.getSize() / bytesPerSample(info.format))) + 0.5);
+			if ((size_t)side * side * bytesPerSample(info.format) == raw.getSize())
+				info.width = info.length = side;
+		}
+	}
+
+	cout<<">> HeightMap: "<<info.width<<"x"<<info.length<<" format:"<<info.format
+			<<" spacing:"<<info.cellSpacing<<" vscale:"<<info.verticalScale<<endl;
+
+	return (info.width > 0) && (info.length > 0);
+}
+
+bool HeightMap::load(const char *filename, const HEIGHTMAPINFO &info)
+{
+	release();
+
+	dWidth = info.width;
+	dLength = info.length;
+
+	bool loaded = false;
+	if (info.format == HEIGHTMAP_TILED)
+	{
+		// streamed, only the tiles in use are read
+		tiles = new TileCache();
+		loaded = tiles->open(filename);
+		if (!loaded)
+		{
+			delete tiles;
+			tiles = NULL;
+		}
+	}
+	else if (file.open(filename))
+	{
+		cout<<">> HeightMap: mapped "<<filename<<" ("<<file.getSize()<<" bytes)"<<endl;
+
+		size_t needed = (size_t)dWidth * dLength * bytesPerSample(info.format);
+
+		if ((info.format != HEIGHTMAP_PGM) && (file.getSize() < needed))
+			cout<<">> HeightMap: "<<filename<<" is smaller than "<<dWidth<<"x"<<dLength<<endl;
+		else if (info.format == HEIGHTMAP_RAW8)
+		{
+			// read in place
+			samples8 = file.getData();
+			rangeScale = 1.0f / 255.0f;
+			loaded = true;
+		}
+		else if (info.format == HEIGHTMAP_RAW16_LE)
+			loaded = loadRaw16(false);
+		else if (info.format == HEIGHTMAP_RAW16_BE)
+			loaded = loadRaw16(true);
+		else if (info.format == HEIGHTMAP_FLOAT32)
+			loaded = loadFloat32();
+		else if (info.format == HEIGHTMAP_PGM)
+			loaded = loadPGM();
+
+		// decoded formats do not need the file any more
+		if (!loaded || (ownSamples16.getData() != NULL))
+			file.close();
+	}
+
+	if (!loaded)
+	{
+		// keep a flat (zero) terrain so that the rest of the system still works
+		cout<<">> HeightMap: ERROR could not load "<<filename<<", using a flat terrain"<<endl;
+		useFlatTerrain(info.width, info.length);
+	}
+
+	return loaded;
+}
+
+bool HeightMap::loadRAW(const char *filename, int width, int length)
+{
+	HEIGHTMAPINFO info;
+	info.format = HEIGHTMAP_RAW8;
+	info.width = width;
+	info.length = length;
+	info.cellSpacing = 1.0f;
+	info.verticalScale = 1.0f;
+
+	return load(filename, info);
+}
+
+bool HeightMap::loadRaw16(bool bigEndian)
+{
+	const uint16_t *raw = (const uint16_t*)file.getData();
+
+	if (bigEndian == !isLittleEndianHost())
+	{
+		// native byte order, read in place
+		samples16 = raw;
+	}
+	else
+	{
+		// swap into a private copy once
+		ownSamples16.allocate(dWidth, dLength);
+		uint16_t *dst = ownSamples16.getData();
+		size_t count = ownSamples16.size();
+		for (size_t i = 0; i < count; i++)
+			dst[i] = swapBytes16(raw[i]);
+		samples16 = dst;
+	}
+
+	setUniformTiles(0.0f, 1.0f / 65535.0f);
+	return true;
+}
+
+// a little endian float from a float32 file
+static float readFloat32(const float *raw, size_t i, bool swap)
+{
+	float value = raw[i];
+	if (swap)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, 4);
+		bits = (bits >> 24) | ((bits >> 8) & 0xff00) | ((bits << 8) & 0xff0000) | (bits << 24);
+		memcpy(&value, &bits, 4);
+	}
+	return value;
+}
+
+bool HeightMap::loadFloat32()
+{
+	const float *raw = (const float*)file.getData();
+	bool swap = !isLittleEndianHost();
+
+	allocateQuantized();
+	vector<float> values(HEIGHTMAP_TILE_SIZE * HEIGHTMAP_TILE_SIZE);
+
+	for (int tx = 0; tx < tileOffset.getWidth(); tx++)
+	{
+		for (int tz = 0; tz < tileOffset.getLength(); tz++)
+		{
+			int x0 = tx * HEIGHTMAP_TILE_SIZE, x1 = min(x0 + HEIGHTMAP_TILE_SIZE, dWidth);
+			int z0 = tz * HEIGHTMAP_TILE_SIZE, z1 = min(z0 + HEIGHTMAP_TILE_SIZE, dLength);
+
+			for (int x = x0; x < x1; x++)
+				for (int z = z0; z < z1; z++)
+					values[(x - x0) * HEIGHTMAP_TILE_SIZE + (z - z0)] = readFloat32(raw, (size_t)x * dLength + z, swap);
+
+			quantizeTile(tx, tz, &values[0]);
+		}
+	}
+
+	samples16 = ownSamples16.getData();
+	return true;
+}
+
+// a procedural heightmap, the tiles are generated and quantized in parallel
+bool HeightMap::generate(const HEIGHTMAPNOISE &noise, ThreadPool &workers)
+{
+	release();
+
+	cout<<">> HeightMap: generating "<<noise.width<<"x"<<noise.length<<" fBm terrain (seed "<<noise.seed
+			<<", "<<noise.octaves<<" octaves)"<<endl;
+
+	dWidth = noise.width;
+	dLength = noise.length;
+	allocateQuantized();
+
+	// each sample only depends on the seed and its position, so the tiles are independent
+	float frequency = 1.0f / noise.featureSize;
+	workers.parallelFor(0, tileOffset.getWidth(), [&](int tx0, int tx1)
+	{
+		vector<float> values(HEIGHTMAP_TILE_SIZE * HEIGHTMAP_TILE_SIZE);
+
+		for (int tx = tx0; tx < tx1; tx++)
+		{
+			for (int tz = 0; tz < tileOffset.getLength(); tz++)
+			{
+				int x0 = tx * HEIGHTMAP_TILE_SIZE, x1 = min(x0 + HEIGHTMAP_TILE_SIZE, dWidth);
+				int z0 = tz * HEIGHTMAP_TILE_SIZE, z1 = min(z0 + HEIGHTMAP_TILE_SIZE, dLength);
+
+				for (int x = x0; x < x1; x++)
+					for (int z = z0; z < z1; z++)
+						values[(x - x0) * HEIGHTMAP_TILE_SIZE + (z - z0)] =
+								fbmNoise(noise.seed, x * frequency, z * frequency, noise.octaves, noise.persistence);
+
+				quantizeTile(tx, tz, &values[0]);
+			}
+		}
+	});
+
+	samples16 = ownSamples16.getData();
+	return true;
+}
+
+// 16-bit samples with a dequantization offset and scale per tile
+void HeightMap::allocateQuantized()
+{
+	ownSamples16.allocate(dWidth, dLength);
+
+	int tilesX = (dWidth + HEIGHTMAP_TILE_SIZE - 1) / HEIGHTMAP_TILE_SIZE;
+	int tilesZ = (dLength + HEIGHTMAP_TILE_SIZE - 1) / HEIGHTMAP_TILE_SIZE;
+	tileOffset.allocate(tilesX, tilesZ);
+	tileScale.allocate(tilesX, tilesZ);
+}
+
+// quantize tile [tx][tz] to 16 bits over its own height range,
+// values holds the tile [x][z] with HEIGHTMAP_TILE_SIZE values per x
+void HeightMap::quantizeTile(int tx, int tz, const float *values)
+{
+	int x0 = tx * HEIGHTMAP_TILE_SIZE, x1 = min(x0 + HEIGHTMAP_TILE_SIZE, dWidth);
+	int z0 = tz * HEIGHTMAP_TILE_SIZE, z1 = min(z0 + HEIGHTMAP_TILE_SIZE, dLength);
+	uint16_t *dst = ownSamples16.getData();
+
+	// find the tile range
+	float lo = values[0];
+	float hi = lo;
+	for (int x = 0; x < x1 - x0; x++)
+	{
+		for (int z = 0; z < z1 - z0; z++)
+		{
+			float value = values[x * HEIGHTMAP_TILE_SIZE + z];
+			lo = min(lo, value);
+			hi = max(hi, value);
+		}
+	}
+
+	float scale = (hi - lo) / 65535.0f;
+	tileOffset[tx][tz] = lo;
+	tileScale[tx][tz] = scale;
+
+	// quantize
+	for (int x = x0; x < x1; x++)
+	{
+		for (int z = z0; z < z1; z++)
+		{
+			float value = values[(x - x0) * HEIGHTMAP_TILE_SIZE + (z - z0)];
+			dst[(size_t)x * dLength + z] = (scale > 0.0f) ? (uint16_t)((value - lo) / scale + 0.5f) : 0;
+		}
+	}
+}
+
+bool HeightMap::loadPGM()
+{
+	const unsigned char *data = file.getData();
+	bool binary;
+	int cols, rows, maxval;
+	size_t offset;
+
+	if (!parsePGMHeader(data, file.getSize(), binary, cols, rows, maxval, offset, NULL)
+			|| (rows != dWidth) || (cols != dLength))
+	{
+		cout<<">> HeightMap: bad PGM header"<<endl;
+		return false;
+	}
+
+	size_t count = (size_t)dWidth * dLength;
+
+	if (binary && (maxval < 256))
+	{
+		// 8-bit P5, read in place
+		if (file.getSize() < offset + count) return false;
+		samples8 = data + offset;
+		rangeScale = 1.0f / maxval;
+		return true;
+	}
+
+	ownSamples16.allocate(dWidth, dLength);
+	uint16_t *dst = ownSamples16.getData();
+
+	if (binary)
+	{
+		// 16-bit P5 samples are big endian
+		if (file.getSize() < offset + count * 2) return false;
+		for (size_t i = 0; i < count; i++)
+			dst[i] = (uint16_t)((data[offset + i*2] << 8) | data[offset + i*2 + 1]);
+	}
+	else
+	{
+		// P2, ascii samples
+		size_t p = offset;
+		size_t size = file.getSize();
+		for (size_t i = 0; i < count; i++)
+		{
+			while ((p < size) && !isdigit(data[p])) p++;
+			if (p >= size) return false;
+
+			unsigned int value = 0;
+			while ((p < size) && isdigit(data[p]))
+				value = value * 10 + (data[p++] - '0');
+			dst[i] = (uint16_t)value;
+		}
+	}
+
+	samples16 = dst;
+	setUniformTiles(0.0f, 1.0f / maxval);
+	return true;
+}
+
+// all tiles share one offset and scale (integer formats)
+void HeightMap::setUniformTiles(float offset, float scale)
+{
+	int tilesX = (dWidth + HEIGHTMAP_TILE_SIZE - 1) / HEIGHTMAP_TILE_SIZE;
+	int tilesZ = (dLength + HEIGHTMAP_TILE_SIZE - 1) / HEIGHTMAP_TILE_SIZE;
+	tileOffset.allocate(tilesX, tilesZ);
+	tileScale.allocate(tilesX, tilesZ);
+
+	for (int tx = 0; tx < tilesX; tx++)
+	{
+		for (int tz = 0; tz < tilesZ; tz++)
+		{
+			tileOffset[tx][tz] = offset;
+			tileScale[tx][tz] = scale;
+		}
+	}
+}
+
+void HeightMap::useFlatTerrain(int width, int length)
+{
+	release();
+
+	dWidth = width;
+	dLength = length;
+	ownSamples8.allocate(width, length);		// elements are zero initialised
+	samples8 = ownSamples8.getData();
+	rangeScale = 1.0f / 255.0f;
+}
+
+void HeightMap::release()
+{
+	delete tiles;
+	tiles = NULL;
+	file.close();
+	ownSamples8.release();
+	ownSamples16.release();
+	tileOffset.release();
+	tileScale.release();
+	samples8 = NULL;
+	samples16 = NULL;
+	dWidth = dLength = 0;
+}
@@ -0,0 +1,121 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ Heightmap Class
+//
+//  The source of the terrain elevation samples, laid out row by
+//  row as sample[x][z]. Supported formats are 8-bit RAW, 16-bit
+//  RAW (little or big endian), 32-bit float RAW and PGM (P2/P5).
+//
+//  8-bit and native-endian 16-bit samples are memory mapped and
+//  read in place (zero-copy). The other formats are decoded once
+//  into 16-bit samples; float data is quantized per tile with a
+//  tile offset and scale, keeping storage at 2 bytes per sample
+//
+//  Each heightmap can carry a small text header with its size,
+//  cell spacing and vertical scale, see readHeader()
+//
+//  A .tiles file is streamed out-of-core through a TileCache
+//
+//  A heightmap can also be generated from seeded noise, for
+//  terrains of any size without a heightmap file
+//
+//	##########################################################
+
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include <stdint.h>
+#include "Array2D.h"
+#include "MappedFile.h"
+#include "TileCache.h"
+#include "ThreadPool.h"
+
+#define HEIGHTMAP_TILE_SHIFT	6		// quantization tiles are 64x64 samples
+#define HEIGHTMAP_TILE_SIZE		(1 << HEIGHTMAP_TILE_SHIFT)
+
+enum HEIGHTMAPFORMAT { HEIGHTMAP_RAW8, HEIGHTMAP_RAW16_LE, HEIGHTMAP_RAW16_BE, HEIGHTMAP_FLOAT32, HEIGHTMAP_PGM, HEIGHTMAP_TILED };
+
+// the per-file metadata of a heightmap
+struct HEIGHTMAPINFO
+{
+	int format;						// HEIGHTMAPFORMAT
+	int width, length;		// number of samples along x and z
+	float cellSpacing;		// distance between samples in OpenGL units
+	float verticalScale;	// world height of a sample of 1.0
+};
+
+// a procedural heightmap: fractal Brownian motion of seeded value noise (TerrainNoise.h),
+// the same seed and settings always give the same terrain
+struct HEIGHTMAPNOISE
+{
+	uint32_t seed;
+	int width, length;		// number of samples along x and z
+	int octaves;					// layers of noise, each adding finer detail
+	float featureSize;		// samples between the lattice points of the first octave
+	float persistence;		// amplitude of an octave relative to the previous one
+	float cellSpacing;		// distance between samples in OpenGL units
+	float verticalScale;	// world height of a sample of 1.0
+};
+
+class HeightMap
+{
+private:
+	MappedFile file;							// the mapped heightmap file
+	Array2D<uint8_t> ownSamples8;		// fallback storage when the file cannot be mapped
+	Array2D<uint16_t> ownSamples16;	// decoded storage for formats that cannot be read in place
+	Array2D<float> tileOffset;		// per tile dequantization offset (16-bit samples)
+	Array2D<float> tileScale;			// per tile dequantization scale (16-bit samples)
+
+	TileCache *tiles;							// streamed tiles (HEIGHTMAP_TILED), or NULL
+	const uint8_t *samples8;			// 8-bit samples in use (mapped or owned), or NULL
+	const uint16_t *samples16;		// 16-bit samples in use (mapped or owned), or NULL
+	float rangeScale;							// converts an 8-bit sample to 0..1
+	int dWidth, dLength;					// number of samples along x and z
+
+	// a heightmap may own a mapping, copying is not allowed
+	HeightMap(const HeightMap &);
+	HeightMap &operator=(const HeightMap &);
+
+	bool loadRaw16(bool bigEndian);
+	bool loadFloat32();
+	bool loadPGM();
+	void allocateQuantized();
+	void quantizeTile(int tx, int tz, const float *values);
+	void setUniformTiles(float offset, float scale);
+	void useFlatTerrain(int width, int length);
+
+public:
+	HeightMap();
+	~HeightMap();
+
+	static bool readHeader(const char *filename, HEIGHTMAPINFO &info);	// read the metadata of a heightmap
+	bool load(const char *filename, const HEIGHTMAPINFO &info);	// load the samples described by info
+	bool loadRAW(const char *filename, int width, int length);	// map an 8-bit RAW file
+	bool generate(const HEIGHTMAPNOISE &noise, ThreadPool &workers);	// a procedural heightmap, 0..1
+	void release();
+
+	// the sample at [x][z], 0..1 for integer formats and the stored value for float formats
+	float getSample(int x, int z) const
+	{
+		size_t i = (size_t)x * dLength + z;
+		if (samples8 != NULL)
+			return samples8[i] * rangeScale;
+		if (tiles != NULL)
+			return tiles->getSample(x, z);
+
+		int tx = x >> HEIGHTMAP_TILE_SHIFT;
+		int tz = z >> HEIGHTMAP_TILE_SHIFT;
+		return tileOffset[tx][tz] + samples16[i] * tileScale[tx][tz];
+	}
+
+	bool isMapped() const { return file.isOpen(); }
+	bool isTiled() const { return tiles != NULL; }
+	TileCache *getTileCache() const { return tiles; }
+	int getWidth() const { return dWidth; }
+	int getLength() const { return dLength; }
+	int getBitsPerSample() const { return (samples8 != NULL) ? 8 : 16; }
+};
+
+#endif
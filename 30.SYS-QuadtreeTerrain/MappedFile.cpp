@@ -0,0 +1,128 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility class
+//
+//  A read-only memory-mapped file: 'MappedFile.h'
+//
+//	##########################################################
+
+#include <iostream>
+#include "MappedFile.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile()
+{
+	data = NULL;
+	size = 0;
+#ifdef WIN32
+	fileHandle = NULL;
+	mapHandle = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const char *filename)
+{
+	close();
+
+#ifdef WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		cout<<">> MappedFile: could not open "<<filename<<endl;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	if (fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		cout<<">> MappedFile: could not map "<<filename<<endl;
+		return false;
+	}
+
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		cout<<">> MappedFile: could not map "<<filename<<endl;
+		return false;
+	}
+
+	size = (size_t)fileSize.QuadPart;
+	fileHandle = file;
+	mapHandle = mapping;
+#else
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		cout<<">> MappedFile: could not open "<<filename<<endl;
+		return false;
+	}
+
+	struct stat info;
+	if ((fstat(fd, &info) != 0) || (info.st_size == 0))
+	{
+		::close(fd);
+		return false;
+	}
+
+	// MAP_SHARED read-only pages come straight from the page cache
+	void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);		// the mapping keeps its own reference to the file
+
+	if (mapping == MAP_FAILED)
+	{
+		cout<<">> MappedFile: could not map "<<filename<<endl;
+		return false;
+	}
+
+	data = mapping;
+	size = (size_t)info.st_size;
+#endif
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data == NULL) return;
+
+#ifdef WIN32
+	UnmapViewOfFile(data);
+	CloseHandle((HANDLE)mapHandle);
+	CloseHandle((HANDLE)fileHandle);
+	mapHandle = NULL;
+	fileHandle = NULL;
+#else
+	munmap(data, size);
+#endif
+
+	data = NULL;
+	size = 0;
+}
@@ -184,7 +184,7 @@ void MoveableOnQTTerrain::notMoving()
   isBackward = false;
 }
 
-void MoveableOnQTTerrain::getTerrain(QTTerrain *terrain)
+void MoveableOnQTTerrain::getTerrain(const TerrainView *terrain)
 {
 	_terrain = terrain;
 }
@@ -16,7 +16,7 @@
 
 #include "OGLUtil.h"
 #include "Object.h"
-#include "QTTerrain.h"
+#include "TerrainView.h"
 
 /****************************** PROTOTYPES ******************************/
 class MoveableOnQTTerrain: public Object
@@ -35,7 +35,7 @@ private:
   // movement flags
 	bool isForward, isBackward, isRight, isLeft, isMoving;
 
-  QTTerrain *_terrain;
+  const TerrainView *_terrain;
 
 public:
   // constructors
@@ -57,7 +57,7 @@ public:
   void stopBackward();
   void notMoving();
 
-  void getTerrain(QTTerrain *terrain);
+  void getTerrain(const TerrainView *terrain);
 
   // visual representation function
   void DrawObject(float red, float green, float blue);
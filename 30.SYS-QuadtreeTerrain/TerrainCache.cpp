@@ -0,0 +1,141 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ Terrain Cache Class
+//
+//  Precomputed terrain file: 'TerrainCache.h'
+//
+//	##########################################################
+
+#include <iostream>
+#include <stdio.h>
+#include "TerrainCache.h"
+
+using namespace std;
+
+// sections start on a cache line
+static uint64_t alignSection(uint64_t offset)
+{
+	return (offset + 63) & ~(uint64_t)63;
+}
+
+TerrainCache::TerrainCache()
+{
+	header = NULL;
+}
+
+uint64_t TerrainCache::checksumFile(const char *filename)
+{
+	MappedFile source;
+	if (!source.open(filename))
+		return 0;
+
+	uint64_t hash = 14695981039346656037ULL;
+	const unsigned char *data = source.getData();
+	for (size_t i = 0; i < source.getSize(); i++)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+bool TerrainCache::write(const char *filename, const TERRAINCACHEHEADER &info, const float *heights,
+												const unsigned char *normals, const TERRAINQUADTREENODE *nodes, const TERRAINQUADTREENODEDATA *nodeData)
+{
+	FILE *f = fopen(filename, "wb");
+	if (f == NULL)
+	{
+		cout<<">> TerrainCache: could not create "<<filename<<endl;
+		return false;
+	}
+
+	size_t count = (size_t)info.width * info.length;
+	size_t normalBytes = NormalBuffer::storedBytes(info.normalStorage);
+
+	TERRAINCACHEHEADER fileHeader = info;
+	fileHeader.magic = TERRAINCACHE_MAGIC;
+	fileHeader.version = TERRAINCACHE_VERSION;
+	fileHeader.nodeBytes = sizeof(TERRAINQUADTREENODE);
+	fileHeader.nodeDataBytes = sizeof(TERRAINQUADTREENODEDATA);
+	fileHeader.heightsOffset = alignSection(sizeof(TERRAINCACHEHEADER));
+	fileHeader.normalsOffset = alignSection(fileHeader.heightsOffset + sizeof(float) * count);
+	fileHeader.nodesOffset = alignSection(fileHeader.normalsOffset + normalBytes * count);
+	fileHeader.nodeDataOffset = alignSection(fileHeader.nodesOffset + sizeof(TERRAINQUADTREENODE) * (uint64_t)info.nodeCount);
+
+	// header and sections, padded up to each section offset
+	const char zeros[64] = {0};
+	fwrite(&fileHeader, sizeof(TERRAINCACHEHEADER), 1, f);
+	fwrite(zeros, 1, fileHeader.heightsOffset - sizeof(TERRAINCACHEHEADER), f);
+	fwrite(heights, sizeof(float), count, f);
+	fwrite(zeros, 1, fileHeader.normalsOffset - (fileHeader.heightsOffset + sizeof(float) * count), f);
+	fwrite(normals, normalBytes, count, f);
+	fwrite(zeros, 1, fileHeader.nodesOffset - (fileHeader.normalsOffset + normalBytes * count), f);
+	fwrite(nodes, sizeof(TERRAINQUADTREENODE), fileHeader.nodeCount, f);
+	fwrite(zeros, 1, fileHeader.nodeDataOffset - (fileHeader.nodesOffset + sizeof(TERRAINQUADTREENODE) * (uint64_t)fileHeader.nodeCount), f);
+	fwrite(nodeData, sizeof(TERRAINQUADTREENODEDATA), fileHeader.nodeCount, f);
+
+	bool ok = (ferror(f) == 0);
+	fclose(f);
+
+	if (ok)
+		cout<<">> TerrainCache: saved "<<filename<<endl;
+	else
+	{
+		cout<<">> TerrainCache: could not write "<<filename<<endl;
+		remove(filename);
+	}
+	return ok;
+}
+
+bool TerrainCache::open(const char *filename)
+{
+	close();
+
+	if (!file.open(filename))
+		return false;
+
+	const TERRAINCACHEHEADER *h = (const TERRAINCACHEHEADER*)file.getData();
+	if ((file.getSize() < sizeof(TERRAINCACHEHEADER)) || (h->magic != TERRAINCACHE_MAGIC)
+			|| (h->version != TERRAINCACHE_VERSION) || (h->nodeBytes != sizeof(TERRAINQUADTREENODE))
+			|| (h->nodeDataBytes != sizeof(TERRAINQUADTREENODEDATA)))
+	{
+		cout<<">> TerrainCache: "<<filename<<" is not a terrain cache of this version"<<endl;
+		file.close();
+		return false;
+	}
+
+	// every section must be inside the file
+	size_t count = (size_t)h->width * h->length;
+	if ((h->heightsOffset + sizeof(float) * count > file.getSize())
+			|| (h->normalsOffset + NormalBuffer::storedBytes(h->normalStorage) * count > file.getSize())
+			|| (h->nodesOffset + sizeof(TERRAINQUADTREENODE) * (uint64_t)h->nodeCount > file.getSize())
+			|| (h->nodeDataOffset + sizeof(TERRAINQUADTREENODEDATA) * (uint64_t)h->nodeCount > file.getSize()))
+	{
+		cout<<">> TerrainCache: "<<filename<<" is truncated"<<endl;
+		file.close();
+		return false;
+	}
+
+	header = h;
+	return true;
+}
+
+void TerrainCache::close()
+{
+	header = NULL;
+	file.close();
+}
+
+bool TerrainCache::matches(const TERRAINCACHEHEADER &expected) const
+{
+	if (header == NULL) return false;
+
+	return (header->sourceChecksum == expected.sourceChecksum)
+			&& (header->width == expected.width) && (header->length == expected.length)
+			&& (header->cellSpacing == expected.cellSpacing) && (header->heightScale == expected.heightScale)
+			&& (header->normalsFlag == expected.normalsFlag) && (header->normalStorage == expected.normalStorage)
+			&& (header->qtLevel == expected.qtLevel);
+}
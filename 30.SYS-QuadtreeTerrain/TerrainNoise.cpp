@@ -0,0 +1,70 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility source
+//
+//  Seeded value noise and fBm: 'TerrainNoise.h'
+//
+//	##########################################################
+
+#include <math.h>
+#include "TerrainNoise.h"
+
+// a well mixed 32-bit hash of a lattice point
+static inline uint32_t hashLattice(uint32_t seed, int32_t x, int32_t z)
+{
+	uint32_t h = seed ^ ((uint32_t)x * 0x8da6b343u) ^ ((uint32_t)z * 0xd8163841u);
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return h;
+}
+
+// the value of a lattice point, 0..1
+static inline float latticeValue(uint32_t seed, int32_t x, int32_t z)
+{
+	return (hashLattice(seed, x, z) >> 8) * (1.0f / 16777215.0f);
+}
+
+// quintic fade, the slope is continuous across lattice points
+static inline float fade(float t)
+{
+	return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+float valueNoise(uint32_t seed, float x, float z)
+{
+	float fx = floorf(x), fz = floorf(z);
+	int32_t ix = (int32_t)fx, iz = (int32_t)fz;
+	float u = fade(x - fx), v = fade(z - fz);
+
+	float v00 = latticeValue(seed, ix, iz);
+	float v10 = latticeValue(seed, ix + 1, iz);
+	float v01 = latticeValue(seed, ix, iz + 1);
+	float v11 = latticeValue(seed, ix + 1, iz + 1);
+
+	float a = v00 + (v10 - v00) * u;
+	float b = v01 + (v11 - v01) * u;
+	return a + (b - a) * v;
+}
+
+float fbmNoise(uint32_t seed, float x, float z, int octaves, float persistence)
+{
+	float sum = 0.0f, amplitude = 1.0f, total = 0.0f;
+
+	for (int i = 0; i < octaves; i++)
+	{
+		// every octave has its own lattice values
+		sum += valueNoise(seed + (uint32_t)i * 0x9e3779b9u, x, z) * amplitude;
+		total += amplitude;
+
+		x *= 2.0f;
+		z *= 2.0f;
+		amplitude *= persistence;
+	}
+
+	return (total > 0.0f) ? sum / total : 0.0f;
+}
@@ -16,26 +16,40 @@
 //#include "OGLUtil.h"
 #include "stdlib.h"
 #include "math.h"
+#include <vector>
 #include "Vector3f.h"
+#include "Frustum.h"
 
 struct VERTICEINDEXINFO { int x, z; };	// vertice index mapping node vertices to indices in terrainData[x][z]
 enum NODETYPE {QT_NODE, QT_LEAF};	// for determining whether the node is leaf
 
+// the deepest tree built: 11 levels is 1398101 nodes (about 212 MB), every level
+// more is four times the nodes, larger terrains get wider leaves instead
+#define QT_MAX_LEVELS	11
+
+// the nodes are split in two arrays indexed by the same node ID: the traversal of
+// the tree (LOD selection, ray casting, height range updates) reads only the small
+// TERRAINQUADTREENODE, drawing a selected node reads its TERRAINQUADTREENODEDATA
+
+// the part of a node read while walking the tree
 struct TERRAINQUADTREENODE
 {
-	int nodeType;								// node or leaf enum
-	int ID;											// my unique ID
-	int parentID;								// for identifying parent
-	float top, bottom, left, right;	// boundary
-	float width, height;					// width and height of the node (bounding box size)
-	Vector3f position;						// a position for comparing distance between this node with camera pos
+	float top, bottom, left, right;	// boundary (for the LOD distance to the camera)
+	float minHeight, maxHeight;		// elevation range of the terrain under the node (with the points, a 3D box)
+	VERTICEINDEXINFO firstVertex, lastVertex;	// the points under the node, verticeIndex[0][0] and [2][2]
+	unsigned char nodeType;			// node or leaf enum
 	bool visible;								// is this node visible for drawing?
 
+	// the 4 quadrants (branches) and the parent are not stored, their array
+	// indices follow from the node ID (see TerrainQuadTree::branchIndex and parentIndex)
+};
 
-	//float terrainWidth;			// a permanent width for calculating
-
-	// the nodes has 4 quadrants (branches), their array index is stored in this variable
-	unsigned int branchIndex[4];
+// the part of a node read when it is drawn
+struct TERRAINQUADTREENODEDATA
+{
+	int ID;											// my unique ID (the index in qtNodeArray)
+	float width, height;					// width and height of the node (bounding box size)
+	Vector3f position;						// the centre of the node, y is the middle of its height range
 
 	// a node has 9 vertices, 3 on each sides 3x3=9
 	// this amounts to 4 cells
@@ -43,36 +57,53 @@ struct TERRAINQUADTREENODE
 
 	// the division level: width/divs = LevelDivs
 	// first level is 32/2^1 = 16, 16 is the division related to the index to terrainData[x][y]
-	int layerID;
+	unsigned int layerID;
 
-	// the variables tells the next node on where to start the verticeIndex from
+	// where the verticeIndex of the node starts
 	int vInitX, vInitZ;
-
-
 };
 
 class TerrainQuadTree
 {
 private:
-	unsigned int leafNodesIndex;	// the indices of the leaf nodes
-	float minSizeOfQuad;		// the size of the lowest level quads (leaf boundary size)
+	unsigned int levels;		// the leaves are on this layer (layerID == levels)
 	//int qt_level;				// quadtree level
 public:
 	TerrainQuadTree();
 	TerrainQuadTree(float _top, float _bottom, float _left, float _right, unsigned int _vertX, unsigned int _vertZ, unsigned int _level);
+	TerrainQuadTree(const TERRAINQUADTREENODE *nodes, const TERRAINQUADTREENODEDATA *nodeData,
+									unsigned int _nodeSize, unsigned int _vertX, unsigned int _vertZ);	// restore a flattened qtNodeArray and qtNodeData
 	~TerrainQuadTree();
 
 	unsigned int vertX;
 	unsigned int vertZ;
+	float originX, originZ;		// the world position of point [0][0] (set by the terrain, see setPointGrid)
+	float cellSpacing;				// the world distance between two points, the same on both axes
 	unsigned int nodeSize;		// the number of nodes calculated from _level
-	TERRAINQUADTREENODE *qtNodeArray;
+	TERRAINQUADTREENODE *qtNodeArray;		// traversal, [nodeSize]
+	TERRAINQUADTREENODEDATA *qtNodeData;	// drawing, [nodeSize]
+
+	// the nodes selected by the last testRenderable (the visible ones), in the order
+	// they were selected; the list keeps its memory from frame to frame
+	std::vector<unsigned int> visibleNodes;
+	unsigned int culledNodes;		// the nodes the last testRenderable rejected outside the view frustum (with their branches)
+
+	// the nodes are stored breadth-first: the root is 0, the 4 branches of node i are
+	// 4i+1..4i+4 (NW, SW, NE, SE) and the nodes of a layer are contiguous
+	static unsigned int branchIndex(unsigned int nodeID, unsigned int quadrant) { return 4 * nodeID + 1 + quadrant; }
+	static unsigned int parentIndex(unsigned int nodeID) { return (nodeID - 1) / 4; }
 
+	static unsigned int levelsForSize(unsigned int vertices, unsigned int leafCells);	// the levels giving leaves of at most leafCells cells
 	unsigned int calculateNodeSize(unsigned int _level);					// how many nodes in number of _level
-	float calculateMinQuadSize(float _width, unsigned int _level);			// for determining when recursion should stop
-	void createQuadTree(TERRAINQUADTREENODE &thisNode);				// create quad tree
+	void createQuadTree(float _top, float _bottom, float _left, float _right);	// create quad tree (layer by layer, no recursion)
 	void adjustVerticeIndex();										// adjust verticeIndex so that the last one is not 32
-	void resetNodeVisibility();										// reset node visibility
-	void testRenderable(TERRAINQUADTREENODE &parentNode, Vector3f pos, float range);	// cam position and chunked LOD
+	void resetNodeVisibility();										// reset node visibility (of the visibleNodes only)
+	void testRenderable(unsigned int nodeID, Vector3f pos, float range,
+											const FRUSTUM *frustum = NULL);	// cam position and chunked LOD, fills visibleNodes
+	void setPointGrid(float _originX, float _originZ, float _cellSpacing);	// where the points are drawn, for outsideFrustum
+	bool outsideFrustum(unsigned int nodeID, const FRUSTUM &frustum);	// the box of the node's points and height range
+	void selectNode(unsigned int nodeID);							// mark a node visible and add it to visibleNodes
+	void mergeBranchBounds(unsigned int nodeID);				// a node's height range from its 4 branches
 	void reportNodeBranchIndex();									// reporter
 };
 
@@ -21,6 +21,7 @@
 //
 //	##########################################################
 
+#include <memory>
 #include "OGLUtil.h"
 #include "Agent.h"
 
@@ -39,6 +40,9 @@ Agent::Agent(): Object(-1)
 
 	isForward = isBackward = isRight = isLeft = false;
 
+	gradient.x = gradient.z = 0.0f;
+	fMaxClimb = 1.0f;		// 45 degrees
+
 	vPos.x = 0.0f;
 	vPos.y = 0.0f;
 	vPos.z = 0.0f;
@@ -60,6 +64,9 @@ Agent::Agent(int _id, float origX, float origY, float origZ, float speed): Objec
 
 	isForward = isBackward = isRight = isLeft = false;
 
+	gradient.x = gradient.z = 0.0f;
+	fMaxClimb = 1.0f;		// 45 degrees
+
 	vPos.x = origX;
 	vPos.y = origY;
 	vPos.z = origZ;
@@ -141,13 +148,12 @@ void Agent::update()
 
 	fCurrAngle += fAngle;
 
-	vPos.x -= fMovement*cos(fCurrAngle * PI/180);
-	vPos.z -= fMovement*sin(fCurrAngle * PI/180);
+	moveOnSlope();
 
 	//cout<<vPos.x<< " "<<vPos.z<<" m:"<<fMovement<<endl;
 	//cout<<" isForward:"<<isForward<<" isBackward"<<isBackward<<" isLeft:"<<isLeft<<" isRight:"<<isRight<<endl;
 
-	placeAgentOnTerrain();
+	// the height is set for all agents of a species at once (Agent::placeAgentsOnTerrain)
 }
 
 void Agent::autonomy()
@@ -251,7 +257,83 @@ void Agent::placeAgentOnTerrain()
 		vPos.y = vPos.y - fabs(dist);
 }
 
-void Agent::getTerrain(QTTerrain *terrain)
+// place a species on the terrain with one batched height query (TerrainView::getHeights)
+void Agent::placeAgentsOnTerrain(Agent **agents, int count, const TerrainView *terrain)
+{
+	if (count <= 0)
+		return;
+
+	vector<float> xs(count), zs(count), heights(count);
+	for(int i=0; i<count; i++)
+	{
+		xs[i] = agents[i]->vPos.x;
+		zs[i] = agents[i]->vPos.z;
+	}
+
+	terrain->getHeights(&xs[0], &zs[0], &heights[0], count);
+
+	// the slope for the next step comes with the height (TerrainView::getGradients)
+	vector<TERRAINGRADIENT> gradients(count);
+	terrain->getGradients(&xs[0], &zs[0], &gradients[0], count);
+
+	for(int i=0; i<count; i++)
+	{
+		agents[i]->vPos.y = heights[i];
+		agents[i]->gradient = gradients[i];
+	}
+}
+
+// slower uphill (a quarter of the speed at fMaxClimb), up to a quarter faster downhill
+float Agent::slopeSpeed()
+{
+	// the agent moves along (cos, sin) of its angle, backwards when fMovement is positive
+	float rise = gradient.x*cos(fCurrAngle * PI/180) + gradient.z*sin(fCurrAngle * PI/180);
+	if (fMovement > 0.0f)
+		rise = -rise;
+
+	if (rise > fMaxClimb)
+		return 0.0f;
+	if (rise > 0.0f)
+		return 1.0f - 0.75f * rise / fMaxClimb;
+	return 1.0f + 0.25f * min(-rise, 1.0f);
+}
+
+// the slope ahead scales the step, a cliff stops it and turns the agent away
+void Agent::moveOnSlope()
+{
+	float slope = slopeSpeed();
+	if (slope == 0.0f)
+		rotateLeft(5.0f);
+
+	vPos.x -= fMovement*slope*cos(fCurrAngle * PI/180);
+	vPos.z -= fMovement*slope*sin(fCurrAngle * PI/180);
+}
+
+// one batched line of sight query from this agent's eyes to the top of each candidate
+void Agent::filterVisible(vector<int> &candidates)
+{
+	if ((_terrain == NULL) || candidates.empty())
+		return;
+
+	int count = (int)candidates.size();
+	vector<Vector3f> from(count, vPos + Vector3f(0.0f, fScale, 0.0f)), to(count);
+	for(int i=0; i<count; i++)
+	{
+		Agent *target = _agents[candidates[i]];
+		to[i] = target->vPos + Vector3f(0.0f, target->fScale, 0.0f);
+	}
+
+	unique_ptr<bool[]> visible(new bool[count]);
+	_terrain->lineOfSight(&from[0], &to[0], count, visible.get());
+
+	int kept = 0;
+	for(int i=0; i<count; i++)
+		if (visible[i])
+			candidates[kept++] = candidates[i];
+	candidates.resize(kept);
+}
+
+void Agent::getTerrain(const TerrainView *terrain)
 {
 	_terrain = terrain;
 }
@@ -25,7 +25,7 @@
 #include "OGLUtil.h"
 #include "Object.h"
 #include "Category.h" // for managing agent types during simulation
-#include "QTTerrain.h"
+#include "TerrainView.h"
 
 /****************************** PROTOTYPES ******************************/
 class Agent: public Object
@@ -55,8 +55,14 @@ protected:
   // World Boundaries
   float _top; float _bottom; float _left; float _right;
 
-  // access to terrain using pointer
-  QTTerrain *_terrain;
+  // access to terrain using pointer (read-only queries, see TerrainView.h)
+  const TerrainView *_terrain;
+
+  // the terrain gradient under the agent, read with its height (placeAgentsOnTerrain)
+  TERRAINGRADIENT gradient;
+  float fMaxClimb;  // the steepest rise per unit of distance the agent walks up
+  float slopeSpeed(); // speed factor for the slope ahead, 0 at a cliff
+  void moveOnSlope(); // one step along fCurrAngle scaled by slopeSpeed, shared by the update() of each species
 
 public:
   // ------------------- constructors destructors
@@ -76,7 +82,10 @@ public:
   // get access to all agents in the world
   void getAgents(Agent **agents, int size);
 
-  void getTerrain(QTTerrain *terrain);
+  void getTerrain(const TerrainView *terrain);
+
+  // keep the agents (IDs in _agents) that the terrain does not hide, nearest first is up to the caller
+  void filterVisible(vector<int> &candidates);
 
   // to be implemented in derived classes
   virtual void seek() {};
@@ -94,6 +103,7 @@ public:
   void notMoving();
 
   void placeAgentOnTerrain();
+  static void placeAgentsOnTerrain(Agent **agents, int count, const TerrainView *terrain);	// once per species per step
 
   // ------------------- visual representation function
   void DrawObject(float red, float green, float blue);
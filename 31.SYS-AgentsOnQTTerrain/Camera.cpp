@@ -43,6 +43,9 @@ Camera::Camera()
 	// angles
 	rotAngle = 0.2f;
 	pitchAngle = 1.0f;
+
+	// perspective, replaced by setPerspective
+	setPerspective(45.0f, 1.0f, 0.1f, 5000.0f);
 }
 
 
@@ -76,6 +79,9 @@ Camera::Camera(Vector3f initialPos, Vector3f initialTarget, float _speed, float
 
 	rotAngle = _rotAngle;	// assign the angle rotate speed
 	pitchAngle = 1.0f;		// assign pitch angle
+
+	// perspective, replaced by setPerspective
+	setPerspective(45.0f, 1.0f, 0.1f, 5000.0f);
 }
 
 Camera::~Camera()
@@ -93,6 +99,55 @@ void Camera::print()
 	cout<<">> position: "<<x<<" "<<y<<" "<<z<<" | target: "<<tx<<" "<<ty<<" "<<tz<<endl;
 }
 
+void Camera::setPerspective(float _fovY, float _aspect, float _zNear, float _zFar)
+{
+	fovY = _fovY;
+	aspect = _aspect;
+	zNear = _zNear;
+	zFar = _zFar;
+}
+
+void Camera::getViewProjection(float *m)
+{
+	// the view (gluLookAt): forward, side and up axes of the camera
+	Vector3f eye(x, y, z);
+	Vector3f forward(tx - x, ty - y, tz - z);
+	forward.normalise();
+	Vector3f side(-forward.z, 0.0f, forward.x);		// forward x (0, 1, 0)
+
+	// looking straight up or down the side is zero (NaN planes would cull everything),
+	// it then follows from the yaw, the heading the camera was turned to
+	if (side.x * side.x + side.z * side.z < 1e-8f)
+		side = Vector3f(-sin(DEG2RAD(yaw)), 0.0f, cos(DEG2RAD(yaw)));
+	else
+		side.normalise();
+	Vector3f up(side.y * forward.z - side.z * forward.y, side.z * forward.x - side.x * forward.z, side.x * forward.y - side.y * forward.x);
+
+	float view[4][4] = {
+		{ side.x, side.y, side.z, -(side.x * eye.x + side.y * eye.y + side.z * eye.z) },
+		{ up.x, up.y, up.z, -(up.x * eye.x + up.y * eye.y + up.z * eye.z) },
+		{ -forward.x, -forward.y, -forward.z, forward.x * eye.x + forward.y * eye.y + forward.z * eye.z },
+		{ 0.0f, 0.0f, 0.0f, 1.0f } };
+
+	// the projection (gluPerspective)
+	float f = 1.0f / tan(DEG2RAD(fovY) / 2.0f);
+	float projection[4][4] = {
+		{ f / aspect, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, (zFar + zNear) / (zNear - zFar), (2.0f * zFar * zNear) / (zNear - zFar) },
+		{ 0.0f, 0.0f, -1.0f, 0.0f } };
+
+	// projection * view, stored by column like glGetFloatv(GL_PROJECTION_MATRIX)
+	for(int row=0; row<4; row++)
+		for(int col=0; col<4; col++)
+		{
+			float sum = 0.0f;
+			for(int k=0; k<4; k++)
+				sum += projection[row][k] * view[k][col];
+			m[col * 4 + row] = sum;
+		}
+}
+
 void Camera::update()
 {
 	// limit yaw and pitch
@@ -0,0 +1,148 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility source
+//
+//  Batched terrain height kernel: 'HeightKernel.h'
+//  Build with -mavx2 (or -march=native) for the AVX2 path,
+//  SSE2 is always available on x86-64
+//
+//	##########################################################
+
+#include <algorithm>
+#include "HeightKernel.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HEIGHTKERNEL_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HEIGHTKERNEL_WIDTH 4
+#else
+#define HEIGHTKERNEL_WIDTH 1
+#endif
+
+using namespace std;
+
+// one position, also used for the end of a batch that does not fill a SIMD register
+static inline float heightAt(const HEIGHTGRID &grid, float x, float z)
+{
+	// grid coordinates, clamped to the grid
+	float gx = min(max((x - grid.originX) * grid.invSpacing, 0.0f), (float)(grid.width - 1));
+	float gz = min(max((z - grid.originZ) * grid.invSpacing, 0.0f), (float)(grid.length - 1));
+
+	// the cell, the last point of a row or column belongs to the cell before it
+	float cx = min((float)(int)gx, (float)(grid.width - 2));
+	float cz = min((float)(int)gz, (float)(grid.length - 2));
+	float fx = gx - cx;
+	float fz = gz - cz;
+
+	const float *h = grid.heights + (size_t)cx * grid.stride + (size_t)cz;
+	float h00 = h[0], h01 = h[1], h10 = h[grid.stride], h11 = h[grid.stride + 1];
+
+	// the triangle holding [x][z] or the one holding [x+1][z+1]
+	if (fx + fz <= 1.0f)
+		return h00 + (h10 - h00) * fx + (h01 - h00) * fz;
+	return h11 + (h01 - h11) * (1.0f - fx) + (h10 - h11) * (1.0f - fz);
+}
+
+void sampleHeightsScalar(const HEIGHTGRID &grid, const float *xs, const float *zs, float *out, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = heightAt(grid, xs[i], zs[i]);
+}
+
+void sampleHeights(const HEIGHTGRID &grid, const float *xs, const float *zs, float *out, size_t n)
+{
+	size_t i = 0;
+
+#if HEIGHTKERNEL_WIDTH == 8
+	__m256 originX = _mm256_set1_ps(grid.originX), originZ = _mm256_set1_ps(grid.originZ);
+	__m256 invSpacing = _mm256_set1_ps(grid.invSpacing);
+	__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+	__m256 maxX = _mm256_set1_ps((float)(grid.width - 1)), maxZ = _mm256_set1_ps((float)(grid.length - 1));
+	__m256 lastX = _mm256_set1_ps((float)(grid.width - 2)), lastZ = _mm256_set1_ps((float)(grid.length - 2));
+	__m256i stride = _mm256_set1_epi32(grid.stride);
+	__m256i oneIndex = _mm256_set1_epi32(1);
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 gx = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(xs + i), originX), invSpacing), zero), maxX);
+		__m256 gz = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(zs + i), originZ), invSpacing), zero), maxZ);
+
+		__m256 cx = _mm256_min_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(gx)), lastX);
+		__m256 cz = _mm256_min_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(gz)), lastZ);
+		__m256 fx = _mm256_sub_ps(gx, cx);
+		__m256 fz = _mm256_sub_ps(gz, cz);
+
+		// gather the 4 corners of each cell
+		__m256i i00 = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(cx), stride), _mm256_cvttps_epi32(cz));
+		__m256i i10 = _mm256_add_epi32(i00, stride);
+		__m256 h00 = _mm256_i32gather_ps(grid.heights, i00, 4);
+		__m256 h01 = _mm256_i32gather_ps(grid.heights, _mm256_add_epi32(i00, oneIndex), 4);
+		__m256 h10 = _mm256_i32gather_ps(grid.heights, i10, 4);
+		__m256 h11 = _mm256_i32gather_ps(grid.heights, _mm256_add_epi32(i10, oneIndex), 4);
+
+		__m256 near = _mm256_add_ps(_mm256_add_ps(h00, _mm256_mul_ps(_mm256_sub_ps(h10, h00), fx)), _mm256_mul_ps(_mm256_sub_ps(h01, h00), fz));
+		__m256 far = _mm256_add_ps(_mm256_add_ps(h11, _mm256_mul_ps(_mm256_sub_ps(h01, h11), _mm256_sub_ps(one, fx))),
+															 _mm256_mul_ps(_mm256_sub_ps(h10, h11), _mm256_sub_ps(one, fz)));
+		__m256 isNear = _mm256_cmp_ps(_mm256_add_ps(fx, fz), one, _CMP_LE_OQ);
+
+		_mm256_storeu_ps(out + i, _mm256_blendv_ps(far, near, isNear));
+	}
+#elif HEIGHTKERNEL_WIDTH == 4
+	__m128 originX = _mm_set1_ps(grid.originX), originZ = _mm_set1_ps(grid.originZ);
+	__m128 invSpacing = _mm_set1_ps(grid.invSpacing);
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	__m128 maxX = _mm_set1_ps((float)(grid.width - 1)), maxZ = _mm_set1_ps((float)(grid.length - 1));
+	__m128 lastX = _mm_set1_ps((float)(grid.width - 2)), lastZ = _mm_set1_ps((float)(grid.length - 2));
+	int cellX[4], cellZ[4];
+
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 gx = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(xs + i), originX), invSpacing), zero), maxX);
+		__m128 gz = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(zs + i), originZ), invSpacing), zero), maxZ);
+
+		__m128 cx = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gx)), lastX);
+		__m128 cz = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gz)), lastZ);
+		__m128 fx = _mm_sub_ps(gx, cx);
+		__m128 fz = _mm_sub_ps(gz, cz);
+
+		// SSE2 has no gather, the 4 corners of each cell are loaded one position at a time
+		_mm_storeu_si128((__m128i*)cellX, _mm_cvttps_epi32(cx));
+		_mm_storeu_si128((__m128i*)cellZ, _mm_cvttps_epi32(cz));
+		const float *h0 = grid.heights + (size_t)cellX[0] * grid.stride + cellZ[0];
+		const float *h1 = grid.heights + (size_t)cellX[1] * grid.stride + cellZ[1];
+		const float *h2 = grid.heights + (size_t)cellX[2] * grid.stride + cellZ[2];
+		const float *h3 = grid.heights + (size_t)cellX[3] * grid.stride + cellZ[3];
+		size_t s = grid.stride;
+		__m128 v00 = _mm_setr_ps(h0[0], h1[0], h2[0], h3[0]);
+		__m128 v01 = _mm_setr_ps(h0[1], h1[1], h2[1], h3[1]);
+		__m128 v10 = _mm_setr_ps(h0[s], h1[s], h2[s], h3[s]);
+		__m128 v11 = _mm_setr_ps(h0[s+1], h1[s+1], h2[s+1], h3[s+1]);
+
+		__m128 near = _mm_add_ps(_mm_add_ps(v00, _mm_mul_ps(_mm_sub_ps(v10, v00), fx)), _mm_mul_ps(_mm_sub_ps(v01, v00), fz));
+		__m128 far = _mm_add_ps(_mm_add_ps(v11, _mm_mul_ps(_mm_sub_ps(v01, v11), _mm_sub_ps(one, fx))),
+														_mm_mul_ps(_mm_sub_ps(v10, v11), _mm_sub_ps(one, fz)));
+		__m128 isNear = _mm_cmple_ps(_mm_add_ps(fx, fz), one);
+
+		_mm_storeu_ps(out + i, _mm_or_ps(_mm_and_ps(isNear, near), _mm_andnot_ps(isNear, far)));
+	}
+#endif
+
+	// the rest of the batch
+	for (; i < n; i++)
+		out[i] = heightAt(grid, xs[i], zs[i]);
+}
+
+const char *heightKernelISA()
+{
+#if HEIGHTKERNEL_WIDTH == 8
+	return "AVX2";
+#elif HEIGHTKERNEL_WIDTH == 4
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
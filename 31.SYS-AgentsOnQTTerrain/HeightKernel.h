@@ -0,0 +1,44 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility header
+//
+//  Terrain heights of many positions at once. Each cell of the
+//  height grid is split into two triangles by the diagonal from
+//  [x][z+1] to [x+1][z] (as in QTTerrain::distanceToPlane) and
+//  the height is interpolated on the triangle under the position
+//
+//  The positions are processed 8 (AVX2) or 4 (SSE) at a time
+//  when the compiler targets those instruction sets, otherwise
+//  one at a time. Positions outside the grid are clamped to its
+//  edge
+//
+//	##########################################################
+
+#ifndef HEIGHTKERNEL_H
+#define HEIGHTKERNEL_H
+
+#include <stddef.h>
+
+// the grid being sampled: heights[x * stride + z], width x length points
+// (at least 2x2), point [0][0] is at (originX, originZ) in world space
+struct HEIGHTGRID
+{
+	const float *heights;
+	int stride;
+	int width, length;
+	float originX, originZ;
+	float invSpacing;		// 1 / distance between points
+};
+
+// out[i] is the height under (xs[i], zs[i])
+void sampleHeights(const HEIGHTGRID &grid, const float *xs, const float *zs, float *out, size_t n);
+
+// the same without SIMD, for comparison
+void sampleHeightsScalar(const HEIGHTGRID &grid, const float *xs, const float *zs, float *out, size_t n);
+
+// the instruction set sampleHeights was built for
+const char *heightKernelISA();
+
+#endif
@@ -0,0 +1,44 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility class
+//
+//  A read-only memory-mapped file. The contents are paged in
+//  on demand by the operating system and shared through the
+//  page cache, so nothing is copied into private memory
+//
+//	##########################################################
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+
+class MappedFile
+{
+private:
+	void *data;			// start of the mapping (NULL when not open)
+	size_t size;		// size of the file in bytes
+#ifdef WIN32
+	void *fileHandle;
+	void *mapHandle;
+#endif
+
+	// a mapping has a single owner, copying is not allowed
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const char *filename);	// map the whole file read-only
+	void close();										// unmap the file
+
+	bool isOpen() const { return data != NULL; }
+	const unsigned char *getData() const { return (const unsigned char*)data; }
+	size_t getSize() const { return size; }
+};
+
+#endif
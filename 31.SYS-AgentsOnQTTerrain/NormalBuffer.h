@@ -0,0 +1,145 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility class
+//
+//  The terrain vertex normals ([x][z]) in one of three storage
+//  formats, chosen at allocation:
+//    NORMALS_FLOAT3	Vector3f, 12 bytes per vertex
+//    NORMALS_OCT16		octahedral 2x16-bit, 4 bytes per vertex
+//    NORMALS_OCT8		octahedral 2x8-bit, 2 bytes per vertex
+//  Encoded normals are decoded when they are read (NormalEncoding.h)
+//
+//	##########################################################
+
+#ifndef NORMALBUFFER_H
+#define NORMALBUFFER_H
+
+#include <string.h>
+#include "Array2D.h"
+#include "NormalEncoding.h"
+
+enum NORMALSTORAGE { NORMALS_FLOAT3, NORMALS_OCT16, NORMALS_OCT8 };
+
+class NormalBuffer
+{
+private:
+	int storage;								// NORMALSTORAGE
+	Array2D<Vector3f> float3;		// only the array of the storage format is allocated
+	Array2D<uint32_t> oct16;
+	Array2D<uint16_t> oct8;
+
+	// a buffer owns its memory, copying is not allowed
+	NormalBuffer(const NormalBuffer &);
+	NormalBuffer &operator=(const NormalBuffer &);
+
+public:
+	NormalBuffer(): storage(NORMALS_FLOAT3) {}
+
+	void allocate(int width, int length, int _storage)
+	{
+		release();
+		storage = _storage;
+
+		if (storage == NORMALS_OCT16)
+			oct16.allocate(width, length);
+		else if (storage == NORMALS_OCT8)
+			oct8.allocate(width, length);
+		else
+			float3.allocate(width, length);
+	}
+
+	void release()
+	{
+		float3.release();
+		oct16.release();
+		oct8.release();
+	}
+
+	// exchange the contents of two buffers (no copy)
+	void swap(NormalBuffer &other)
+	{
+		int otherStorage = other.storage;
+		other.storage = storage;
+		storage = otherStorage;
+
+		float3.swap(other.float3);
+		oct16.swap(other.oct16);
+		oct8.swap(other.oct8);
+	}
+
+	Vector3f get(int x, int z) const
+	{
+		if (storage == NORMALS_OCT16)
+			return unpackOct16(oct16[x][z]);
+		if (storage == NORMALS_OCT8)
+			return unpackOct8(oct8[x][z]);
+		return float3[x][z];
+	}
+
+	void set(int x, int z, const Vector3f &n)
+	{
+		if (storage == NORMALS_OCT16)
+			oct16[x][z] = packOct16(n);
+		else if (storage == NORMALS_OCT8)
+			oct8[x][z] = packOct8(n);
+		else
+			float3[x][z] = n;
+	}
+
+	// count normals of row x from z0
+	void setRow(int x, int z0, int count, const Vector3f *normals)
+	{
+		for (int i = 0; i < count; i++)
+			set(x, z0 + i, normals[i]);
+	}
+
+	// the bytes of a normal as stored in a format, the terrain cache keeps them as they are
+	static size_t storedBytes(int _storage)
+	{
+		if (_storage == NORMALS_OCT16)
+			return sizeof(uint32_t);
+		if (_storage == NORMALS_OCT8)
+			return sizeof(uint16_t);
+		return 3 * sizeof(float);
+	}
+
+	void getStored(int x, int z, unsigned char *bytes) const
+	{
+		if (storage == NORMALS_OCT16)
+			memcpy(bytes, &oct16[x][z], sizeof(uint32_t));
+		else if (storage == NORMALS_OCT8)
+			memcpy(bytes, &oct8[x][z], sizeof(uint16_t));
+		else
+		{
+			const Vector3f &n = float3[x][z];
+			float v[3] = { n.x, n.y, n.z };
+			memcpy(bytes, v, sizeof(v));
+		}
+	}
+
+	void setStored(int x, int z, const unsigned char *bytes)
+	{
+		if (storage == NORMALS_OCT16)
+			memcpy(&oct16[x][z], bytes, sizeof(uint32_t));
+		else if (storage == NORMALS_OCT8)
+			memcpy(&oct8[x][z], bytes, sizeof(uint16_t));
+		else
+		{
+			float v[3];
+			memcpy(v, bytes, sizeof(v));
+			float3[x][z] = Vector3f(v[0], v[1], v[2]);
+		}
+	}
+
+	// row access for NORMALS_FLOAT3 (NULL for the encoded formats)
+	Vector3f *getFloat3Row(int x) { return (storage == NORMALS_FLOAT3) ? float3[x] : NULL; }
+
+	int getStorage() const { return storage; }
+	int getWidth() const { return float3.getWidth() + oct16.getWidth() + oct8.getWidth(); }
+	int getLength() const { return float3.getLength() + oct16.getLength() + oct8.getLength(); }
+	size_t bytes() const { return float3.bytes() + oct16.bytes() + oct8.bytes(); }
+};
+
+#endif
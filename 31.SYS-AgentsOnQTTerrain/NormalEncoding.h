@@ -0,0 +1,98 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility header
+//
+//  Octahedral normal encoding: a unit normal is projected onto
+//  an octahedron and unfolded into a square, giving two values
+//  in -1..1 that are quantized into a small integer. y is the
+//  axis of the unfolding because terrain normals point up
+//
+//	##########################################################
+
+#ifndef NORMALENCODING_H
+#define NORMALENCODING_H
+
+#include <stdint.h>
+#include <math.h>
+#include <iostream>
+#include "Vector3f.h"
+
+// unit normal to octahedral u, v in -1..1
+inline void octEncode(const Vector3f &n, float &u, float &v)
+{
+	float sum = fabs(n.x) + fabs(n.y) + fabs(n.z);
+	if (sum == 0.0f)
+	{
+		// a missing normal is stored as pointing up
+		u = v = 0.0f;
+		return;
+	}
+
+	u = n.x / sum;
+	v = n.z / sum;
+
+	// fold the lower hemisphere over the diagonals
+	if (n.y < 0.0f)
+	{
+		float fu = (1.0f - fabs(v)) * ((u >= 0.0f) ? 1.0f : -1.0f);
+		float fv = (1.0f - fabs(u)) * ((v >= 0.0f) ? 1.0f : -1.0f);
+		u = fu;
+		v = fv;
+	}
+}
+
+// octahedral u, v in -1..1 to unit normal
+inline Vector3f octDecode(float u, float v)
+{
+	Vector3f n(u, 1.0f - fabs(u) - fabs(v), v);
+
+	// unfold the lower hemisphere
+	if (n.y < 0.0f)
+	{
+		n.x = (1.0f - fabs(v)) * ((u >= 0.0f) ? 1.0f : -1.0f);
+		n.z = (1.0f - fabs(u)) * ((v >= 0.0f) ? 1.0f : -1.0f);
+	}
+
+	n.normalise();
+	return n;
+}
+
+// two signed 16-bit values in 32 bits
+inline uint32_t packOct16(const Vector3f &n)
+{
+	float u, v;
+	octEncode(n, u, v);
+
+	int16_t qu = (int16_t)floor(u * 32767.0f + 0.5f);
+	int16_t qv = (int16_t)floor(v * 32767.0f + 0.5f);
+	return ((uint32_t)(uint16_t)qu << 16) | (uint16_t)qv;
+}
+
+inline Vector3f unpackOct16(uint32_t packed)
+{
+	int16_t qu = (int16_t)(packed >> 16);
+	int16_t qv = (int16_t)(packed & 0xFFFF);
+	return octDecode(qu / 32767.0f, qv / 32767.0f);
+}
+
+// two signed 8-bit values in 16 bits
+inline uint16_t packOct8(const Vector3f &n)
+{
+	float u, v;
+	octEncode(n, u, v);
+
+	int8_t qu = (int8_t)floor(u * 127.0f + 0.5f);
+	int8_t qv = (int8_t)floor(v * 127.0f + 0.5f);
+	return (uint16_t)(((uint16_t)(uint8_t)qu << 8) | (uint8_t)qv);
+}
+
+inline Vector3f unpackOct8(uint16_t packed)
+{
+	int8_t qu = (int8_t)(packed >> 8);
+	int8_t qv = (int8_t)(packed & 0xFF);
+	return octDecode(qu / 127.0f, qv / 127.0f);
+}
+
+#endif
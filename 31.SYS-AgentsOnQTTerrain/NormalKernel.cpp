@@ -0,0 +1,119 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility source
+//
+//  Central difference normal kernel: 'NormalKernel.h'
+//  Build with -mavx2 (or -march=native) for the AVX path,
+//  SSE2 is always available on x86-64
+//
+//	##########################################################
+
+#include <math.h>
+#include "NormalKernel.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define NORMALKERNEL_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NORMALKERNEL_WIDTH 4
+#else
+#define NORMALKERNEL_WIDTH 1
+#endif
+
+// one vertex, also used for the end of a row that does not fill a SIMD register
+static inline void normalAt(const float *up, const float *centre, const float *down,
+														float twoSpacing, Vector3f *normals, int z)
+{
+	float dx = up[z] - down[z];
+	float dz = centre[z] - centre[z+2];
+	float invLength = 1.0f / sqrtf(dx*dx + twoSpacing*twoSpacing + dz*dz);
+
+	normals[z].x = dx * invLength;
+	normals[z].y = twoSpacing * invLength;
+	normals[z].z = dz * invLength;
+}
+
+void computeNormalRowScalar(const float *up, const float *centre, const float *down,
+														float twoSpacing, Vector3f *normals, int length)
+{
+	for (int z = 0; z < length; z++)
+		normalAt(up, centre, down, twoSpacing, normals, z);
+}
+
+void computeNormalRow(const float *up, const float *centre, const float *down,
+											float twoSpacing, Vector3f *normals, int length)
+{
+	int z = 0;
+
+#if NORMALKERNEL_WIDTH == 8
+	__m256 ny2 = _mm256_set1_ps(twoSpacing * twoSpacing);
+	__m256 ny = _mm256_set1_ps(twoSpacing);
+	__m256 one = _mm256_set1_ps(1.0f);
+	float nx[8], nyOut[8], nz[8];
+
+	for (; z + 8 <= length; z += 8)
+	{
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(up + z), _mm256_loadu_ps(down + z));
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(centre + z), _mm256_loadu_ps(centre + z + 2));
+
+		__m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), ny2), _mm256_mul_ps(dz, dz));
+		__m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSq));
+
+		_mm256_storeu_ps(nx, _mm256_mul_ps(dx, invLength));
+		_mm256_storeu_ps(nyOut, _mm256_mul_ps(ny, invLength));
+		_mm256_storeu_ps(nz, _mm256_mul_ps(dz, invLength));
+
+		// Vector3f is stored x, y, z per vertex
+		for (int i = 0; i < 8; i++)
+		{
+			normals[z+i].x = nx[i];
+			normals[z+i].y = nyOut[i];
+			normals[z+i].z = nz[i];
+		}
+	}
+#elif NORMALKERNEL_WIDTH == 4
+	__m128 ny2 = _mm_set1_ps(twoSpacing * twoSpacing);
+	__m128 ny = _mm_set1_ps(twoSpacing);
+	__m128 one = _mm_set1_ps(1.0f);
+	float nx[4], nyOut[4], nz[4];
+
+	for (; z + 4 <= length; z += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(up + z), _mm_loadu_ps(down + z));
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(centre + z), _mm_loadu_ps(centre + z + 2));
+
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), ny2), _mm_mul_ps(dz, dz));
+		__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+
+		_mm_storeu_ps(nx, _mm_mul_ps(dx, invLength));
+		_mm_storeu_ps(nyOut, _mm_mul_ps(ny, invLength));
+		_mm_storeu_ps(nz, _mm_mul_ps(dz, invLength));
+
+		// Vector3f is stored x, y, z per vertex
+		for (int i = 0; i < 4; i++)
+		{
+			normals[z+i].x = nx[i];
+			normals[z+i].y = nyOut[i];
+			normals[z+i].z = nz[i];
+		}
+	}
+#endif
+
+	// the rest of the row
+	for (; z < length; z++)
+		normalAt(up, centre, down, twoSpacing, normals, z);
+}
+
+const char *normalKernelISA()
+{
+#if NORMALKERNEL_WIDTH == 8
+	return "AVX";
+#elif NORMALKERNEL_WIDTH == 4
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
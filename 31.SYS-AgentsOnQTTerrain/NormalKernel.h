@@ -0,0 +1,36 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility header
+//
+//  Vertex normals of a row of terrain heights by central
+//  differences, n = (h[x-1] - h[x+1], 2 * spacing, h[z-1] - h[z+1])
+//  normalised. The row is processed 8 (AVX) or 4 (SSE) vertices
+//  at a time when the compiler targets those instruction sets,
+//  otherwise one at a time
+//
+//  The centre row must be padded by one height at each end (a
+//  copy of the edge height) so that no vertex needs a branch
+//
+//	##########################################################
+
+#ifndef NORMALKERNEL_H
+#define NORMALKERNEL_H
+
+#include <iostream>
+#include "Vector3f.h"
+
+// the normals of one row: up and down are the neighbouring rows (length heights),
+// centre is the row itself with one padding height at each end (length + 2)
+void computeNormalRow(const float *up, const float *centre, const float *down,
+											float twoSpacing, Vector3f *normals, int length);
+
+// the same without SIMD, for comparison
+void computeNormalRowScalar(const float *up, const float *centre, const float *down,
+														float twoSpacing, Vector3f *normals, int length);
+
+// the instruction set computeNormalRow was built for
+const char *normalKernelISA();
+
+#endif
@@ -127,13 +127,12 @@ void Predator::update()
 
 	fCurrAngle += fAngle;
 
-	vPos.x -= fMovement*cos(fCurrAngle * PI/180);
-	vPos.z -= fMovement*sin(fCurrAngle * PI/180);
+	moveOnSlope();
 
 	//cout<<vPos.x<< " "<<vPos.z<<" m:"<<fMovement<<endl;
 	//cout<<" isForward:"<<isForward<<" isBackward"<<isBackward<<" isLeft:"<<isLeft<<" isRight:"<<isRight<<endl;
 
-	placeAgentOnTerrain();
+	// the height is set for all agents of a species at once (Agent::placeAgentsOnTerrain)
 }
 
 void Predator::autonomy()
@@ -180,6 +179,7 @@ void Predator::autonomy()
 
 void Predator::seek()
 {
+  vector<int> candidates;
   for(int i = 0; i < _noOfAgents; i++)
   {
       Vector3f p = _agents[i]->getPosition();
@@ -191,13 +191,16 @@ void Predator::seek()
 
 					// test if within viewing angle
           if(visibleVec.z < fov)
-          {
-						// assign target ID if a prey is within eyesight
-            _preyID = i;
-            break;
-          }
+            candidates.push_back(i);
         }
   }
+
+  // the terrain may hide them, all are tested in one query
+  filterVisible(candidates);
+
+	// assign target ID if a prey is within eyesight
+  if (!candidates.empty())
+    _preyID = candidates[0];
 }
 
 void Predator::chase()
@@ -121,13 +121,12 @@ void Prey::update()
 
 	fCurrAngle += fAngle;
 
-	vPos.x -= fMovement*cos(fCurrAngle * PI/180);
-	vPos.z -= fMovement*sin(fCurrAngle * PI/180);
+	moveOnSlope();
 
 	//cout<<vPos.x<< " "<<vPos.z<<" m:"<<fMovement<<endl;
 	//cout<<" isForward:"<<isForward<<" isBackward"<<isBackward<<" isLeft:"<<isLeft<<" isRight:"<<isRight<<endl;
 
-	placeAgentOnTerrain();
+	// the height is set for all agents of a species at once (Agent::placeAgentsOnTerrain)
 }
 
 void Prey::autonomy()
@@ -174,6 +173,7 @@ void Prey::autonomy()
 
 void Prey::seek()
 {
+  vector<int> candidates;
   for(int i = 0; i < _noOfAgents; i++)
   {
       Vector3f p = _agents[i]->getPosition();
@@ -185,13 +185,16 @@ void Prey::seek()
 
 					// test if within viewing angle
           if(visibleVec.z < fov)
-          {
-						// assign target ID if a prey is within eyesight
-            _preyID = i;
-            break;
-          }
+            candidates.push_back(i);
         }
   }
+
+  // the terrain may hide them, all are tested in one query
+  filterVisible(candidates);
+
+	// assign target ID if a prey is within eyesight
+  if (!candidates.empty())
+    _preyID = candidates[0];
 }
 
 void Prey::chase()
@@ -10,7 +10,15 @@
 //
 //	##########################################################
 
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string.h>
+#include <float.h>
 #include "QTTerrain.h"
+#include "NormalEncoding.h"
+#include "NormalKernel.h"
+#include "HeightKernel.h"
 using namespace std;
 
 SDL_Surface *surface;
@@ -22,10 +30,11 @@ int normalsFlag = NORMAL_SMOOTH;
 //Vector3f **terrainData = NULL;
 
 // LOAD RAW FILE
-QTTerrain::QTTerrain(char *terrainFilename, const int width, const int length, float scaleH, float scale, int _normalsFlag)
+QTTerrain::QTTerrain(char *terrainFilename, const int width, const int length, float scaleH, float scale, int _normalsFlag, int _normalStorage,
+										 int _heightLookup)
 {
 	cout<<"---------------------------------->> Creating Terrain"<<endl;
-	_wireFrame = false;
+	stageStart = chrono::steady_clock::now();
 	// -------------------------------------------------------- instantiate dynamic memory
 	// initialization and output
 
@@ -46,20 +55,71 @@ QTTerrain::QTTerrain(char *terrainFilename, const int width, const int length, f
 	*/
 
 
-	cout<<">> Initialising 2D <Vector> terrainData"<<endl;
-	for(int x = 0; x <= width+1; x++)
-	{
-		terrainData.push_back( vector<Vector3f>() );
-		for(int z = 0; z <= length+1; z++)
-		{
-			//terrainData[x].push_back(Vector3f(x, 0.0f, z));
-			terrainData[x].push_back(Vector3f(0.0f, 0.0f, 0.0f));
+	// map the RAW heightmap file, the samples are read in place (no copy)
+	cout<<">> Opening heightField: "<<terrainFilename<<endl;
+	heightField.loadRAW(terrainFilename, width, length);
+	//printTerrainData(); // print out the file
+	recordStage("load heightmap");
 
-			// print out the 2D arrays
-			//terrainData[x][z].print();
-		}
+	// scaleH is relative to the cell spacing
+	normalStorage = _normalStorage;
+	heightLookup = _heightLookup;
+	createTerrain(terrainFilename, scale, scaleH * scale, _normalsFlag);
+}
+
+// LOAD A HEIGHTMAP DESCRIBED BY ITS HEADER (RAW8, RAW16, FLOAT32, PGM)
+QTTerrain::QTTerrain(char *terrainFilename, int _normalsFlag, int _normalStorage, int _heightLookup)
+{
+	cout<<"---------------------------------->> Creating Terrain"<<endl;
+	stageStart = chrono::steady_clock::now();
+
+	// the header carries the size, cell spacing and vertical scale
+	HEIGHTMAPINFO info;
+	if (!HeightMap::readHeader(terrainFilename, info))
+	{
+		cout<<">> ERROR: could not read the size of heightField: "<<terrainFilename<<endl;
+		throw runtime_error("QTTerrain: no heightmap header");
 	}
 
+	cout<<">> Opening heightField: "<<terrainFilename<<endl;
+	heightField.load(terrainFilename, info);
+	recordStage("load heightmap");
+
+	normalStorage = _normalStorage;
+	heightLookup = _heightLookup;
+	createTerrain(terrainFilename, info.cellSpacing, info.verticalScale, _normalsFlag);
+}
+
+// GENERATE A PROCEDURAL HEIGHTMAP (fBm noise, see HeightMap.h)
+QTTerrain::QTTerrain(const HEIGHTMAPNOISE &noise, int _normalsFlag, int _normalStorage, int _heightLookup)
+{
+	cout<<"---------------------------------->> Creating Terrain"<<endl;
+	stageStart = chrono::steady_clock::now();
+
+	heightField.generate(noise, workers);
+	recordStage("generate heightmap");
+
+	// there is no heightmap file, so no terrain cache
+	normalStorage = _normalStorage;
+	heightLookup = _heightLookup;
+	createTerrain(NULL, noise.cellSpacing, noise.verticalScale, _normalsFlag);
+}
+
+// build the terrain points, normals and quadtree from the loaded heightField
+void QTTerrain::createTerrain(const char *sourceFilename, float spacing, float heightScale, int _normalsFlag)
+{
+
+	_wireFrame = false;
+	_edgemode = false;
+	_frustumCulling = true;
+
+	// width and height of terrain (also vertex grids)
+	dWidth = heightField.getWidth();
+	dHeight = heightField.getLength();
+
+	// a tiled heightField is streamed, the terrain points, normals and cells
+	// are then computed from the resident tiles instead of being stored
+	streaming = heightField.isTiled();
 
 	/*
 	cout<<">> Initialising 2D <Vector> terrainNormals"<<endl;
@@ -73,47 +133,17 @@ QTTerrain::QTTerrain(char *terrainFilename, const int width, const int length, f
 	}
 	*/
 
-	/*
-	cout<<">> Initialising 2D <Vector> heightField"<<endl;
-	// allocate an array of rows Vector3f in the memory
-	heightField = new uint8_t*[width];
-
-	// allocation new cols to the terrain[row] - the next dimension of Vector3f array
-	for(int z = 0; z < width; z++)	heightField[z] = new uint8_t[length];	// allocate the col to the row
-
-
-	for(int x = 0; x < width; x++)
+	// allocate the height and normal arrays for this terrain size
+	if (!streaming)
 	{
-		for(int z = 0; z < length; z++)
-		{
-			heightField[x][z] = 0.0f;
-
-			// print out the 2D arrays
-			//terrainData[x][z].print();
-		}
+		cout<<">> Allocating "<<dWidth<<"x"<<dHeight<<" terrain arrays"<<endl;
+		terrainHeights.allocate(dWidth+2, dHeight+2);		// the padding rows and columns stay at 0
+		terrainNormals.allocate(dWidth, dHeight, normalStorage);
 	}
-	*/
-
-	// open the terrain texture heightmap file
-	cout<<">> Opening heightField: "<<terrainFilename<<endl;
-	theFile = fopen(terrainFilename, "rb");  // rb means reading in data as binary (not writing out)
-
-	// this reads only RAW files
-	// read in the data from "theFile" into "heightField"	from the start of the file "1"
-	// until "width*height" then stop
-	// fread(pointer to file, size per read (1 byte), size of file, the file);
-	fread(heightField, 1, width * length, theFile);
-	fclose(theFile); // close the file after reading
-	theFile = NULL;
-	//printTerrainData(); // print out the file
-
-	// width and height of terrain (also vertex grids)
-	dWidth = width;
-	dHeight = length;
 
 	// scaling factor
-	scaleHeight = scaleH;
-	terrainScale = scale;
+	scaleHeight = heightScale;
+	terrainScale = spacing;
 
 	// adjustment for setting terrain centre at origin
 	adjFromOrig = (terrainScale*dWidth)/2;
@@ -124,26 +154,73 @@ QTTerrain::QTTerrain(char *terrainFilename, const int width, const int length, f
 	boundary.left = -adjFromOrig;
 	boundary.right = adjFromOrig;
 
-	// Load texture
-	char texFile[] = "green.bmp";
-	LoadTexture(texFile);
+	// the texture is loaded by uploadTextures() on the main thread, SDL is not
+	// initialised yet when the terrain is built on a worker thread
 
+	normalsFlag = _normalsFlag;	// flag assigned to global variable
+	if (!streaming)
+	{
+		// a terrain cache built from the same heightmap skips the calculations
+		TERRAINCACHEHEADER cacheInfo;
+		describeCache(sourceFilename, cacheInfo);
+		string cacheFilename = (sourceFilename != NULL) ? string(sourceFilename) + ".qtc" : string();
+		recordStage("checksum heightmap");
+
+		if (loadCache(cacheFilename.c_str(), cacheInfo))
+			recordStage("load cache");
+		else
+		{
+			generateTerrainPoints();
+			recordStage("terrain points");
 
-	generateTerrainPoints();
-	calculateCellBoundary();
+			//cout<<"@@@@@@@@@@@@@@@@ "<<terrainData[31][31].x<<" "<<terrainData[31][31].y<<" "<<terrainData[31][31].z<<endl;
 
-	//cout<<"@@@@@@@@@@@@@@@@ "<<terrainData[31][31].x<<" "<<terrainData[31][31].y<<" "<<terrainData[31][31].z<<endl;
+			// calculate the terrain normals
+			calculateNormals(normalsFlag);
+			recordStage("normals");
 
-	// calculate the terrain normals
-	normalsFlag = _normalsFlag;	// flag assigned to global variable
-	calculateNormals(normalsFlag);
+			// generate QuadTree-based Chunked LOD
+			terrainQT = new TerrainQuadTree(boundary.top, boundary.bottom, boundary.left, boundary.right,
+														dWidth, dHeight, cacheInfo.qtLevel);
+			terrainQT->setPointGrid(-adjFromOrig, -adjFromOrig, terrainScale);
+			buildNodeBounds();
+			recordStage("quadtree");
 
-	// generate QuadTree-based Chunked LOD
-	terrainQT = new TerrainQuadTree(boundary.top, boundary.bottom, boundary.left, boundary.right,
-												dWidth, dHeight, 7);
+			saveCache(cacheFilename.c_str(), cacheInfo);
+			recordStage("save cache");
+		}
+
+		// the gradients are derived from the normals, they are not kept in the cache
+		terrainGradients.allocate(dWidth, dHeight);
+		calculateGradients(0, 0, dWidth, dHeight);
+		recordStage("gradients");
+
+		// the plane table is derived from the heights, it is not kept in the cache
+		if (heightLookup == HEIGHTS_FROM_PLANES)
+		{
+			cellPlanes.allocate(dWidth, dHeight);
+			calculateCellPlanes(0, 0, dWidth, dHeight);
+			recordStage("cell planes");
+		}
+	}
+	else
+	{
+		cout<<">> Streaming terrain: points and normals are computed from the tiles"<<endl;
+		if (heightLookup == HEIGHTS_FROM_PLANES)
+			cout<<">> Streaming terrain: no plane table, heights are found from the terrain points"<<endl;
+
+		// generate QuadTree-based Chunked LOD
+		terrainQT = new TerrainQuadTree(boundary.top, boundary.bottom, boundary.left, boundary.right,
+													dWidth, dHeight, quadTreeLevels());
+		terrainQT->setPointGrid(-adjFromOrig, -adjFromOrig, terrainScale);
+		buildNodeBounds();
+		recordStage("quadtree");
+	}
+
+	reportStartup();
 
 	// set terrain quadtree view range
-	viewRange = (width*scale)/2;
+	viewRange = (dWidth*terrainScale)/2;
 	cout<<"----- Terrain View Range: "<<viewRange<<endl;
 
 	//terrainQT->testRenderable(terrainQT->qtNodeArray[0], Vector3f(66.2504, 76.7355, -41.5497), 100.0f);
@@ -164,12 +241,129 @@ QTTerrain::QTTerrain(char *terrainFilename, const int width, const int length, f
 	//printTerrainData();
 }
 
+// the settings a terrain cache must have been built with
+void QTTerrain::describeCache(const char *sourceFilename, TERRAINCACHEHEADER &cacheInfo)
+{
+	memset(&cacheInfo, 0, sizeof(TERRAINCACHEHEADER));
+	cacheInfo.sourceChecksum = (sourceFilename != NULL) ? TerrainCache::checksumFile(sourceFilename) : 0;
+	cacheInfo.width = dWidth;
+	cacheInfo.length = dHeight;
+	cacheInfo.cellSpacing = terrainScale;
+	cacheInfo.heightScale = scaleHeight;
+	cacheInfo.normalsFlag = normalsFlag;
+	cacheInfo.normalStorage = normalStorage;
+	cacheInfo.qtLevel = quadTreeLevels();
+}
+
+// the larger side decides, so that no leaf is wider than QTTERRAIN_LEAF_CELLS
+unsigned int QTTerrain::quadTreeLevels() const
+{
+	int size = (dWidth > dHeight) ? dWidth : dHeight;
+	return TerrainQuadTree::levelsForSize(size, QTTERRAIN_LEAF_CELLS);
+}
+
+// restore the terrain points, normals and quadtree from a terrain cache
+bool QTTerrain::loadCache(const char *cacheFilename, const TERRAINCACHEHEADER &cacheInfo)
+{
+	if (cacheInfo.sourceChecksum == 0)
+		return false;		// no heightmap file (generated) or it could not be read
+
+	TerrainCache cache;
+	if (!cache.open(cacheFilename))
+		return false;
+
+	if (!cache.matches(cacheInfo))
+	{
+		cout<<">> TerrainCache: "<<cacheFilename<<" is out of date, rebuilding"<<endl;
+		return false;
+	}
+
+	cout<<">> Loading terrain cache: "<<cacheFilename<<endl;
+
+	const float *heights = cache.getHeights();
+	const unsigned char *normals = cache.getNormals();
+	size_t normalBytes = NormalBuffer::storedBytes(normalStorage);
+	workers.parallelFor(0, dWidth, [&](int x0, int x1)
+	{
+		for(int x=x0; x<x1; x++)
+		{
+			for(int z=0; z<dHeight; z++)
+			{
+				size_t i = (size_t)x * dHeight + z;
+				terrainHeights[x][z] = heights[i];
+				terrainNormals.setStored(x, z, normals + i * normalBytes);
+			}
+		}
+	});
+
+	terrainQT = new TerrainQuadTree(cache.getNodes(), cache.getNodeData(), cache.getHeader().nodeCount, dWidth, dHeight);
+	terrainQT->setPointGrid(-adjFromOrig, -adjFromOrig, terrainScale);
+	return true;
+}
+
+// save the terrain points, normals and quadtree for the next run
+void QTTerrain::saveCache(const char *cacheFilename, TERRAINCACHEHEADER &cacheInfo)
+{
+	if (cacheInfo.sourceChecksum == 0)
+		return;		// the heightmap could not be read, nothing worth keeping
+
+	vector<float> heights((size_t)dWidth * dHeight);
+	size_t normalBytes = NormalBuffer::storedBytes(normalStorage);
+	vector<unsigned char> normals((size_t)dWidth * dHeight * normalBytes);
+	workers.parallelFor(0, dWidth, [&](int x0, int x1)
+	{
+		for(int x=x0; x<x1; x++)
+		{
+			for(int z=0; z<dHeight; z++)
+			{
+				size_t i = (size_t)x * dHeight + z;
+				heights[i] = terrainHeights[x][z];
+				terrainNormals.getStored(x, z, &normals[i * normalBytes]);
+			}
+		}
+	});
+
+	cacheInfo.nodeCount = terrainQT->nodeSize;
+	TerrainCache::write(cacheFilename, cacheInfo, &heights[0], &normals[0], terrainQT->qtNodeArray, terrainQT->qtNodeData);
+}
+
+// time since the last stage (or the start of the constructor)
+void QTTerrain::recordStage(const char *name)
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+	STAGETIME stage;
+	stage.name = name;
+	stage.ms = chrono::duration<double, milli>(now - stageStart).count();
+	stageTimes.push_back(stage);
+
+	stageStart = now;
+}
+
+void QTTerrain::reportStartup()
+{
+	double total = 0.0;
+	cout<<">> Terrain startup ("<<workers.getThreadCount()<<" threads):"<<endl;
+	for(size_t i=0; i<stageTimes.size(); i++)
+	{
+		cout<<"   "<<stageTimes[i].name<<": "<<stageTimes[i].ms<<" ms"<<endl;
+		total += stageTimes[i].ms;
+	}
+	cout<<">> Terrain ready in "<<total<<" ms"<<endl;
+}
+
 QTTerrain::~QTTerrain()
 {
 	//delete terrainData;
 	glDeleteTextures( 1, &texture );
 	cout<<">> Textures deleted!"<<endl;
 
+	// the image is still held when the texture was never uploaded
+	if ( surface ) {
+		SDL_FreeSurface( surface );
+		surface = NULL;
+	}
+
 	// this is important!!! Can it be freed from within QTTerrainQuadTree.cpp??
 	// free(terrainQT->qtNodeArray);
 
@@ -188,16 +382,31 @@ QTTerrain::~QTTerrain()
 
 }
 
+// read the texture image (SDL must be initialised), uploadTextures() gives it to OpenGL
 void QTTerrain::LoadTexture(char *textureFile)
 {
 	cout<<">> Loading terrain textures..."<<endl;
 
+	nOfColors = 3;
+
+	if( !(surface = SDL_LoadBMP(textureFile)) )
+	{
+		printf("SDL could not load image.bmp: %s\n", SDL_GetError());
+		//SDL_Quit();
+	}
+}
+
+// load the texture image and create the OpenGL texture, on the main thread once SDL
+// and the GL context exist (the terrain itself may be built on another thread)
+void QTTerrain::uploadTextures()
+{
+	char texFile[] = "green.bmp";
+	LoadTexture(texFile);
+
 	glEnable( GL_TEXTURE_2D );	// enable 2D texture
 	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE ); // env
 
-	nOfColors = 3;
-
-	if( surface = SDL_LoadBMP(textureFile) )
+	if( surface )
 	{
 
 		// Have OpenGL generate a texture object handle for us
@@ -231,15 +440,11 @@ void QTTerrain::LoadTexture(char *textureFile)
 		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	// Linear Filtering
 		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);	// Linear Filtering
 	}
-	else
-	{
-		printf("SDL could not load image.bmp: %s\n", SDL_GetError());
-		//SDL_Quit();
-	}
 
 	// Free the SDL_Surface only if it was successfully created
 	if ( surface ) {
 		SDL_FreeSurface( surface );
+		surface = NULL;
 	}
 }
 
@@ -265,17 +470,17 @@ void QTTerrain::printTerrainData() // print out the file
 		{
 			//printf("%d, %d, %d\n", x, z, heightField[x][z]);
 			//cout<<x<<" "<<z<<" "<<(float)heightField[x][z]<<" ";
-			if ((float)heightField[x][z] == 0)
+			if (heightField.getSample(x, z) == 0)
 				cout<<"nil...   ";
 			else
-				cout<<(float)heightField[x][z]<<" ";
+				cout<<heightField.getSample(x, z)<<" ";
 		}
 		cout<<" \n"<<endl;
 	}
 
 }
 
-void QTTerrain::render(Vector3f cameraPos)
+void QTTerrain::render(Vector3f cameraPos, const float *viewProjection)
 {
 	glEnable(GL_TEXTURE_2D);
 	glEnable(GL_LIGHTING);
@@ -298,10 +503,19 @@ void QTTerrain::render(Vector3f cameraPos)
 
 	// for texture coordinates
 
-	// update quadtree LOD based on Camera position
+	// update quadtree LOD based on Camera position, and the camera view when it is given
+	FRUSTUM frustum;
+	bool culling = _frustumCulling && (viewProjection != NULL);
+	if (culling)
+		extractFrustum(viewProjection, frustum);
+
 	terrainQT->resetNodeVisibility();
-	terrainQT->testRenderable(terrainQT->qtNodeArray[0],
-		Vector3f(cameraPos.x, cameraPos.y, cameraPos.z), viewRange);
+	terrainQT->testRenderable(0,
+		Vector3f(cameraPos.x, cameraPos.y, cameraPos.z), viewRange, culling ? &frustum : NULL);
+
+	// queue the tiles of the selected nodes for the background loader
+	if (streaming)
+		prefetchVisibleTiles();
 
 	//cout<<terrainData[511][0].x<<" "<<terrainData[511][0].y<<" "<<terrainData[511][0].z<<endl;
 	glPushMatrix();
@@ -316,18 +530,17 @@ void QTTerrain::render(Vector3f cameraPos)
 	// ----------------------------------------------------->> draw QUADTREE NODES
 	int vX;
 	int vZ;
-	// run through all the nodes and test if each node, based on the camera position
-	// is visible, if it is, render it.
-	for(int i=0; i<terrainQT->nodeSize; i++)
+	// run through the nodes selected for the camera position (visibleNodes) and render them
+	for(size_t n=0; n<terrainQT->visibleNodes.size(); n++)
 	{
+		unsigned int i = terrainQT->visibleNodes[n];
 		//cout<<"node ["<<i<<"] "<<terrainQT->qtNodeArray[i].visible<<endl;
 
-		// if the node is visible, draw it's vertices
-		if (terrainQT->qtNodeArray[i].visible == true)
+		// draw the node's vertices
 		{
 			// cout<<"NODE:"<<i<<" is visible"<<endl;
 			// cout<<"node ["<<i<<"] "<<terrainQT->qtNodeArray[i].visible<<" | cam:"<<cameraPos.x<<" "<<cameraPos.z<<endl;
-			// grap hold of the verticeIndex and map it to terrainData[x][z]
+			// grap hold of the verticeIndex and map it to terrainHeights[x][z]
 			// cout<<"VERTICES ----"<<endl;
 			const int quadSize = 3-1;
 
@@ -344,38 +557,34 @@ void QTTerrain::render(Vector3f cameraPos)
 				glBegin(GL_TRIANGLE_STRIP);	// this needs to be in the first loop so that the 'strip' is drawn properly
 				for(int z=0; z<quadSize; z++)
 				{
-					vX = terrainQT->qtNodeArray[i].verticeIndex[x][z].x;
-					vZ = terrainQT->qtNodeArray[i].verticeIndex[x][z].z;
+					vX = terrainQT->qtNodeData[i].verticeIndex[x][z].x;
+					vZ = terrainQT->qtNodeData[i].verticeIndex[x][z].z;
 					// cout<<"vertex 0: "<<vX<<" "<<vZ<<endl;
 
-					glNormal3f(terrainNormals[vX][vZ].x, terrainNormals[vX][vZ].y, terrainNormals[vX][vZ].z);
-					glVertex3f(terrainData[vX][vZ].x, terrainData[vX][vZ].y, terrainData[vX][vZ].z);
+					drawVertex(vX, vZ);
 
-					vX = terrainQT->qtNodeArray[i].verticeIndex[x][z+1].x;
-					vZ = terrainQT->qtNodeArray[i].verticeIndex[x][z+1].z;
+					vX = terrainQT->qtNodeData[i].verticeIndex[x][z+1].x;
+					vZ = terrainQT->qtNodeData[i].verticeIndex[x][z+1].z;
 					// cout<<"vertex 1: "<<vX<<" "<<vZ<<endl;
 
-					glNormal3f(terrainNormals[vX][vZ].x, terrainNormals[vX][vZ].y, terrainNormals[vX][vZ].z);
-					glVertex3f(terrainData[vX][vZ].x, terrainData[vX][vZ].y, terrainData[vX][vZ].z);
+					drawVertex(vX, vZ);
 
-					vX = terrainQT->qtNodeArray[i].verticeIndex[x+1][z].x;
-					vZ = terrainQT->qtNodeArray[i].verticeIndex[x+1][z].z;
+					vX = terrainQT->qtNodeData[i].verticeIndex[x+1][z].x;
+					vZ = terrainQT->qtNodeData[i].verticeIndex[x+1][z].z;
 					// cout<<"vertex 2: "<<vX<<" "<<vZ<<endl;
 
 					//cout<<"normals accessing vertex 2: "<<vX<<" "<<vZ<<endl;
-					glNormal3f(terrainNormals[vX][vZ].x, terrainNormals[vX][vZ].y, terrainNormals[vX][vZ].z);
 					//cout<<"terrainData accessing vertex 2: "<<vX<<" "<<vZ<<endl;
-					glVertex3f(terrainData[vX][vZ].x, terrainData[vX][vZ].y, terrainData[vX][vZ].z);
+					drawVertex(vX, vZ);
 
 					// cout<<"before vertex 3: "<<vX<<" "<<vZ<<endl;
-					vX = terrainQT->qtNodeArray[i].verticeIndex[x+1][z+1].x;
-					vZ = terrainQT->qtNodeArray[i].verticeIndex[x+1][z+1].z;
+					vX = terrainQT->qtNodeData[i].verticeIndex[x+1][z+1].x;
+					vZ = terrainQT->qtNodeData[i].verticeIndex[x+1][z+1].z;
 					// cout<<"vertex 3: "<<vX<<" "<<vZ<<endl;
 
 					// cout<<"--normals 3: "<<vX<<" "<<vZ<<endl;
-					glNormal3f(terrainNormals[vX][vZ].x, terrainNormals[vX][vZ].y, terrainNormals[vX][vZ].z);
 					// cout<<"--terrainData 3: "<<vX<<" "<<vZ<<endl;
-					glVertex3f(terrainData[vX][vZ].x, terrainData[vX][vZ].y, terrainData[vX][vZ].z);
+					drawVertex(vX, vZ);
 				}
 				// cout<<"VERTICES ---- END"<<endl;
 				// cout<<"..glEnd"<<endl;
@@ -394,33 +603,29 @@ void QTTerrain::render(Vector3f cameraPos)
 					glBegin(GL_TRIANGLE_STRIP);	// this needs to be in the first loop so that the 'strip' is drawn properly
 					for(int z=0; z<quadSize; z++)
 					{
-						vX = terrainQT->qtNodeArray[i].verticeIndex[x][z].x;
-						vZ = terrainQT->qtNodeArray[i].verticeIndex[x][z].z;
+						vX = terrainQT->qtNodeData[i].verticeIndex[x][z].x;
+						vZ = terrainQT->qtNodeData[i].verticeIndex[x][z].z;
 						// cout<<"vertex 0: "<<vX<<" "<<vZ<<endl;
 
-						glNormal3f(terrainNormals[vX][vZ].x, terrainNormals[vX][vZ].y, terrainNormals[vX][vZ].z);
-						glVertex3f(terrainData[vX][vZ].x, terrainData[vX][vZ].y, terrainData[vX][vZ].z);
+						drawVertex(vX, vZ);
 
-						vX = terrainQT->qtNodeArray[i].verticeIndex[x][z+1].x;
-						vZ = terrainQT->qtNodeArray[i].verticeIndex[x][z+1].z;
+						vX = terrainQT->qtNodeData[i].verticeIndex[x][z+1].x;
+						vZ = terrainQT->qtNodeData[i].verticeIndex[x][z+1].z;
 						// cout<<"vertex 1: "<<vX<<" "<<vZ<<endl;
 
-						glNormal3f(terrainNormals[vX][vZ].x, terrainNormals[vX][vZ].y, terrainNormals[vX][vZ].z);
-						glVertex3f(terrainData[vX][vZ].x, terrainData[vX][vZ].y, terrainData[vX][vZ].z);
+						drawVertex(vX, vZ);
 
-						vX = terrainQT->qtNodeArray[i].verticeIndex[x+1][z].x;
-						vZ = terrainQT->qtNodeArray[i].verticeIndex[x+1][z].z;
+						vX = terrainQT->qtNodeData[i].verticeIndex[x+1][z].x;
+						vZ = terrainQT->qtNodeData[i].verticeIndex[x+1][z].z;
 						// cout<<"vertex 2: "<<vX<<" "<<vZ<<endl;
 
-						glNormal3f(terrainNormals[vX][vZ].x, terrainNormals[vX][vZ].y, terrainNormals[vX][vZ].z);
-						glVertex3f(terrainData[vX][vZ].x, terrainData[vX][vZ].y, terrainData[vX][vZ].z);
+						drawVertex(vX, vZ);
 
-						vX = terrainQT->qtNodeArray[i].verticeIndex[x+1][z+1].x;
-						vZ = terrainQT->qtNodeArray[i].verticeIndex[x+1][z+1].z;
+						vX = terrainQT->qtNodeData[i].verticeIndex[x+1][z+1].x;
+						vZ = terrainQT->qtNodeData[i].verticeIndex[x+1][z+1].z;
 						// cout<<"vertex 3: "<<vX<<" "<<vZ<<endl;
 
-						glNormal3f(terrainNormals[vX][vZ].x, terrainNormals[vX][vZ].y, terrainNormals[vX][vZ].z);
-						glVertex3f(terrainData[vX][vZ].x, terrainData[vX][vZ].y, terrainData[vX][vZ].z);
+						drawVertex(vX, vZ);
 					}
 					// cout<<"VERTICES ---- END"<<endl;
 
@@ -435,73 +640,134 @@ void QTTerrain::render(Vector3f cameraPos)
 }
 
 // update is not needed
-void QTTerrain::update() { }
+// once per frame, before the agents
+void QTTerrain::update()
+{
+	lock_guard<mutex> guard(sightLock);
+	sightCache.clear();
+}
 
-// loop through the x and z (vertices) with heightField points as y
-// store each point in the terrainData 2D array.
-void QTTerrain::generateTerrainPoints()
+// the vertex normal at [x][z]
+Vector3f QTTerrain::vertexNormal(int x, int z) const
 {
-	cout<<">> Generating Terrain Points..."<<endl;
-	// adjustments to align the terrain origin to the world origin
+	if (!streaming)
+		return terrainNormals.get(x, z);
+
+	// central differences of the neighbouring heights
+	Vector3f vN = Vector3f(	height(x-1, z) - height(x+1, z),
+													2.0f * terrainScale,
+													height(x, z-1) - height(x, z+1));
+	vN.normalise();
+	return vN;
+}
 
-	for(int x=0; x<dWidth; x++)					// x
+void QTTerrain::drawVertex(int x, int z)
+{
+	Vector3f n = vertexNormal(x, z);
+	Vector3f v = vertex(x, z);
+	glNormal3f(n.x, n.y, n.z);
+	glVertex3f(v.x, v.y, v.z);
+}
+
+// ask the tile cache for the tiles under the vertices of every visible node,
+// they are read by the background loader while this frame is drawn
+void QTTerrain::prefetchVisibleTiles()
+{
+	TileCache *tiles = heightField.getTileCache();
+
+	tileRequests.clear();
+	for(size_t n=0; n<terrainQT->visibleNodes.size(); n++)
 	{
-		//cout<<"----  x :: "<<x<<"---------------"<<endl;
-		for(int z=0; z<dHeight; z++)					// z
-		{
-			// store vector of each point, build row x at col z first
-			terrainData[x][z] = Vector3f(	x*terrainScale - adjFromOrig,
-																		(heightField[x][z] / 255.0f) * scaleHeight * terrainScale,	// y from height map
-																		z*terrainScale - adjFromOrig
-																	);
-
-			//cout<<x<<" "<<" "<<z<<endl;
-			// cout<<"terrainData----------["<<terrainData[x][z].x<<" "<<terrainData[x][z].y<<" "<<terrainData[x][z].z<<"]"<<endl;
-		}
+		unsigned int i = terrainQT->visibleNodes[n];
+		for(int x=0; x<3; x++)
+			for(int z=0; z<3; z++)
+			{
+				int vX = terrainQT->qtNodeData[i].verticeIndex[x][z].x;
+				int vZ = terrainQT->qtNodeData[i].verticeIndex[x][z].z;
+				vX = (vX < 0) ? 0 : ((vX >= dWidth) ? dWidth-1 : vX);
+				vZ = (vZ < 0) ? 0 : ((vZ >= dHeight) ? dHeight-1 : vZ);
+				tileRequests.push_back(tiles->tileKey(vX, vZ));
+			}
+	}
+
+	sort(tileRequests.begin(), tileRequests.end());
+	tileRequests.erase(unique(tileRequests.begin(), tileRequests.end()), tileRequests.end());
+	tiles->prefetch(tileRequests);
+}
+
+void QTTerrain::setTileBudget(size_t bytes)
+{
+	if (streaming)
+		heightField.getTileCache()->setMemoryBudget(bytes);
+}
 
+void QTTerrain::reportTileCache()
+{
+	if (streaming)
+		heightField.getTileCache()->reportStats();
+	else
+	{
+		const char *storageNames[] = { "float3", "oct16", "oct8" };
+		cout<<">> Terrain is resident: "<<dWidth<<"x"<<dHeight<<" samples ("<<heightField.getBitsPerSample()<<" bits)"
+				<<" | heights: "<<terrainHeights.bytes()<<" bytes | normals ("<<storageNames[terrainNormals.getStorage()]<<"): "
+				<<terrainNormals.bytes()<<" bytes";
+		cout<<" | gradients: "<<terrainGradients.bytes()<<" bytes";
+		if (cellPlanes.getWidth() > 0)
+			cout<<" | cell planes: "<<cellPlanes.bytes()<<" bytes";
+		cout<<endl;
 	}
-	cout<<">> Terrain Points Generated Successfully"<<endl;
+
+	// the LOD selection walks only the traversal part of the nodes
+	cout<<">> Quadtree: "<<terrainQT->nodeSize<<" nodes | traversal: "<<sizeof(TERRAINQUADTREENODE)
+			<<" bytes per node | drawing: "<<sizeof(TERRAINQUADTREENODEDATA)<<" bytes per node"<<endl;
+	cout<<">> Last frame: "<<terrainQT->visibleNodes.size()<<" nodes drawn | "<<terrainQT->culledNodes
+			<<" culled outside the view frustum"<<(_frustumCulling ? "" : " (culling is off)")<<endl;
 }
 
-// this calculates each cell's boundary (each cell is made up of 4 vertices)
-// the rationale for this is so that we can determine which 3 vertices to calculate the normals
-// for getting the height map of the terrain
-void QTTerrain::calculateCellBoundary()
+// loop through the x and z (vertices) with heightField points as y
+// store each height in the terrainHeights 2D array.
+void QTTerrain::generateTerrainPoints()
 {
-	cout<<">> Calculating cell boundary..."<<endl;
+	cout<<">> Generating Terrain Points..."<<endl;
+	// adjustments to align the terrain origin to the world origin
 
-	for(int x=0; x < dWidth; x++)								// x
+	// rows are independent, they are shared by the thread pool
+	workers.parallelFor(0, dWidth, [this](int x0, int x1)
 	{
-		//cout<<"----  x :: "<<x<<"---------------"<<endl;
-		for(int z=0; z<dHeight; z++)								// z
+		for(int x=x0; x<x1; x++)					// x
 		{
-			cellinfo[x][z].top = z * terrainScale - adjFromOrig;			// top
-			cellinfo[x][z].bottom = (z+1) * terrainScale - adjFromOrig;	// bottom
-			cellinfo[x][z].left = x * terrainScale - adjFromOrig;			// left
-			cellinfo[x][z].right = (x+1) * terrainScale - adjFromOrig;		// right
+			//cout<<"----  x :: "<<x<<"---------------"<<endl;
+			for(int z=0; z<dHeight; z++)					// z
+			{
+				// store the height of each point, x and z follow from the indices (see vertex())
+				terrainHeights[x][z] = heightField.getSample(x, z) * scaleHeight;	// y from height map
 
-			//cout<<"z:"<<z<<"    top:"<<cellinfo[x][z].top<<" bottom:"<<cellinfo[x][z].bottom<<" left:"<<cellinfo[x][z].left<<" right:"<<cellinfo[x][z].right<<endl;
-		}
-	}
+				//cout<<x<<" "<<" "<<z<<endl;
+				// cout<<"terrainHeights----------["<<terrainHeights[x][z]<<"]"<<endl;
+			}
 
+		}
+	});
+	cout<<">> Terrain Points Generated Successfully"<<endl;
 }
 
-float QTTerrain::getHeight(Vector3f pos)
+float QTTerrain::getHeight(const Vector3f &pos) const
 {
 	float terrainHeight = 0.0f;
 
 	// check if the position is within the terrain boundary
 	if(withinBoundary(pos, boundary))
 	{
+		// the table gives the height of the plane directly
+		if (cellPlanes.getWidth() > 0)
+		{
+			float normalY;
+			return planeHeight(pos, normalY);
+		}
 
-		// check the distance to the plane
-		float dist = distanceToPlane(pos);
-
-		// now calculate the height of the terrain
-		if (dist <= 0.0)						// the pos is under the plane
-			terrainHeight = pos.y + fabs(dist);
-		else
-			terrainHeight = pos.y - fabs(dist);
+		// the height of the triangle under pos (not the distance to its plane,
+		// which is shorter on a slope), the same as getHeights and the plane table
+		getHeights(&pos.x, &pos.z, &terrainHeight, 1);
 
 		//cout<<"position is within terrain boundary: "<<terrainHeight<<endl;
 	}
@@ -513,30 +779,638 @@ float QTTerrain::getHeight(Vector3f pos)
 	return terrainHeight;
 }
 
-void QTTerrain::posToArrayIndex(Vector3f &pos, int &inX, int &inZ)
+// the surface heights under n positions (xs[i], zs[i]), interpolated on the triangle
+// of the cell under each position like distanceToPlane, vectorised (HeightKernel.h)
+void QTTerrain::getHeights(const float *xs, const float *zs, float *out, size_t n) const
+{
+	if (!streaming)
+	{
+		HEIGHTGRID grid;
+		grid.heights = terrainHeights.getData();
+		grid.stride = terrainHeights.getLength();
+		grid.width = dWidth;
+		grid.length = dHeight;
+		grid.originX = grid.originZ = -adjFromOrig;
+		grid.invSpacing = 1.0f / terrainScale;
+		sampleHeights(grid, xs, zs, out, n);
+		return;
+	}
+
+	// streamed heights are read from the tiles one position at a time
+	for(size_t i=0; i<n; i++)
+	{
+		float gx = min(max((xs[i] + adjFromOrig) / terrainScale, 0.0f), (float)(dWidth - 1));
+		float gz = min(max((zs[i] + adjFromOrig) / terrainScale, 0.0f), (float)(dHeight - 1));
+		int x = min((int)gx, dWidth - 2);
+		int z = min((int)gz, dHeight - 2);
+		float fx = gx - x, fz = gz - z;
+
+		if (fx + fz <= 1.0f)
+			out[i] = height(x, z) + (height(x+1, z) - height(x, z)) * fx + (height(x, z+1) - height(x, z)) * fz;
+		else
+			out[i] = height(x+1, z+1) + (height(x, z+1) - height(x+1, z+1)) * (1.0f - fx)
+						 + (height(x+1, z) - height(x+1, z+1)) * (1.0f - fz);
+	}
+}
+
+// the surface normal at pos, interpolated from the 4 vertex normals of its cell
+Vector3f QTTerrain::getNormal(const Vector3f &pos) const
+{
+	if (!withinBoundary(pos, boundary))
+		return Vector3f(0.0f, 1.0f, 0.0f);
+
+	int inX, inZ;
+	posToArrayIndex(pos, inX, inZ);
+	int x1 = min(inX+1, dWidth-1);
+	int z1 = min(inZ+1, dHeight-1);
+
+	// position within the cell, 0..1
+	float fx = (pos.x + adjFromOrig) / terrainScale - inX;
+	float fz = (pos.z + adjFromOrig) / terrainScale - inZ;
+
+	Vector3f n = vertexNormal(inX, inZ) * ((1-fx) * (1-fz)) + vertexNormal(x1, inZ) * (fx * (1-fz))
+						 + vertexNormal(inX, z1) * ((1-fx) * fz) + vertexNormal(x1, z1) * (fx * fz);
+	n.normalise();
+	return n;
+}
+
+// the gradient of the surface y = h(x, z) is (-n.x / n.y, -n.z / n.y) for its upward normal n
+void QTTerrain::calculateGradients(int x0, int z0, int x1, int z1)
+{
+	workers.parallelFor(x0, x1, [this, z0, z1](int r0, int r1)
+	{
+		for(int x=r0; x<r1; x++)
+		{
+			for(int z=z0; z<z1; z++)
+			{
+				Vector3f n = terrainNormals.get(x, z);
+				float invY = (n.y > 0.0f) ? 1.0f / n.y : 0.0f;
+				terrainGradients[x][z].x = -n.x * invY;
+				terrainGradients[x][z].z = -n.z * invY;
+			}
+		}
+	}, 16);
+}
+
+TERRAINGRADIENT QTTerrain::pointGradient(int x, int z) const
+{
+	if (!streaming)
+		return terrainGradients[x][z];
+
+	Vector3f n = vertexNormal(x, z);
+	TERRAINGRADIENT gradient;
+	gradient.x = -n.x / n.y;
+	gradient.z = -n.z / n.y;
+	return gradient;
+}
+
+TERRAINGRADIENT QTTerrain::getGradient(const Vector3f &pos) const
+{
+	TERRAINGRADIENT gradient;
+	getGradients(&pos.x, &pos.z, &gradient, 1);
+	return gradient;
+}
+
+float QTTerrain::getSlope(const Vector3f &pos) const
+{
+	TERRAINGRADIENT gradient = getGradient(pos);
+	return sqrtf(gradient.x*gradient.x + gradient.z*gradient.z);
+}
+
+// the gradients under n positions, interpolated from the 4 points of the cell under each
+// position (positions off the terrain are clamped to its edge)
+void QTTerrain::getGradients(const float *xs, const float *zs, TERRAINGRADIENT *out, size_t n) const
+{
+	for(size_t i=0; i<n; i++)
+	{
+		float gx = min(max((xs[i] + adjFromOrig) / terrainScale, 0.0f), (float)(dWidth - 1));
+		float gz = min(max((zs[i] + adjFromOrig) / terrainScale, 0.0f), (float)(dHeight - 1));
+		int x = min((int)gx, dWidth - 2);
+		int z = min((int)gz, dHeight - 2);
+		float fx = gx - x, fz = gz - z;
+
+		TERRAINGRADIENT g00 = pointGradient(x, z), g10 = pointGradient(x+1, z);
+		TERRAINGRADIENT g01 = pointGradient(x, z+1), g11 = pointGradient(x+1, z+1);
+		out[i].x = (g00.x * (1-fx) + g10.x * fx) * (1-fz) + (g01.x * (1-fx) + g11.x * fx) * fz;
+		out[i].z = (g00.z * (1-fx) + g10.z * fx) * (1-fz) + (g01.z * (1-fx) + g11.z * fx) * fz;
+	}
+}
+
+void QTTerrain::posToArrayIndex(const Vector3f &pos, int &inX, int &inZ) const
 {
 	// precalculate the halfWidth and halfHeight
 	float halfWidth = dWidth/2;
 	float halfHeight = dHeight/2;
 
 	// dereference inX and inZ
-	// convert the position to the index of the terrainData[x][z]
+	// convert the position to the index of the terrainHeights[x][z]
 	// "pos.x/adjFromOrig" is the ratio of the pos in relation to the terrain.
 	inX = floor((pos.x/adjFromOrig) * halfWidth + halfWidth);
 	inZ = floor((pos.z/adjFromOrig) * halfHeight + halfHeight);
 }
 
-bool QTTerrain::withinBoundary(Vector3f pos, CELLINFO bounds)
+// each polygon (quad) is a cell (made up of 4 vertices), its boundary
+// is a function of the cell index so it is computed rather than stored
+CELLINFO QTTerrain::cellBounds(int x, int z) const
 {
-	if ((pos.x > bounds.left) && (pos.x < bounds.right))
-		if ((pos.z > bounds.top) && (pos.z < bounds.bottom))
-			return true;
+	CELLINFO bounds;
+	bounds.top = z * terrainScale - adjFromOrig;
+	bounds.bottom = (z+1) * terrainScale - adjFromOrig;
+	bounds.left = x * terrainScale - adjFromOrig;
+	bounds.right = (x+1) * terrainScale - adjFromOrig;
+	return bounds;
+}
+
+// write the heights of a rectangle of points, the part outside the terrain is ignored
+void QTTerrain::setHeights(int x0, int z0, int width, int length, const float *heights)
+{
+	if (streaming)
+	{
+		cout<<">> Streaming terrain: heights are read from the tiles and cannot be edited"<<endl;
+		return;
+	}
+
+	// the points of the rectangle that are on the terrain
+	int ex0 = max(x0, 0), ex1 = min(x0 + width, dWidth);
+	int ez0 = max(z0, 0), ez1 = min(z0 + length, dHeight);
+	if ((ex0 >= ex1) || (ez0 >= ez1))
+		return;
+
+	for(int x=ex0; x<ex1; x++)
+		for(int z=ez0; z<ez1; z++)
+			terrainHeights[x][z] = heights[(size_t)(x - x0) * length + (z - z0)];
+
+	// a vertex normal depends on its neighbouring points, so the normals one point
+	// around the rectangle change as well
+	refreshNormals(max(ex0-1, 0), max(ez0-1, 0), min(ex1+1, dWidth), min(ez1+1, dHeight));
+	calculateGradients(max(ex0-1, 0), max(ez0-1, 0), min(ex1+1, dWidth), min(ez1+1, dHeight));
+
+	// and so do the planes of the cells that have an edited point as a corner
+	if (cellPlanes.getWidth() > 0)
+		calculateCellPlanes(max(ex0-1, 0), max(ez0-1, 0), ex1, ez1);
+	{
+		lock_guard<mutex> guard(sightLock);
+		sightCache.clear();
+	}
+	refreshNodes(ex0, ez0, ex1, ez1);
+}
+
+// read the heights of a rectangle of points, in the layout of setHeights (0 outside the terrain)
+void QTTerrain::readHeights(int x0, int z0, int width, int length, float *heights)
+{
+	for(int x=x0; x<x0+width; x++)
+	{
+		for(int z=z0; z<z0+length; z++)
+		{
+			bool onTerrain = (x >= 0) && (x < dWidth) && (z >= 0) && (z < dHeight);
+			heights[(size_t)(x - x0) * length + (z - z0)] = onTerrain ? height(x, z) : 0.0f;
+		}
+	}
+}
+
+// recompute the normals of the points [x0, x1) x [z0, z1)
+void QTTerrain::refreshNormals(int x0, int z0, int x1, int z1)
+{
+	// small edits run on the calling thread (parallelFor does not split them)
+	workers.parallelFor(x0, x1, [this, z0, z1](int r0, int r1)
+	{
+		if (normalsFlag == NORMAL_CENTRAL)
+			calculateCentralNormalRows(r0, r1, z0, z1, true);
 		else
+			calculateNormalRows(normalsFlag, r0, r1, z0, z1);
+	}, 16);
+}
+
+// update the nodes covering the points [x0, x1) x [z0, z1), from the leaves up to the root
+void QTTerrain::refreshNodes(int x0, int z0, int x1, int z1)
+{
+	vector<unsigned int> leaves;
+	findEditedLeaves(0, x0, z0, x1-1, z1-1, leaves);
+
+	// the leaves of an edit share most of their ancestors, each node is updated once
+	vector<bool> marked(terrainQT->nodeSize, false);
+	vector<unsigned int> nodes;
+	for(size_t i=0; i<leaves.size(); i++)
+	{
+		unsigned int nodeID = leaves[i];
+		while (!marked[nodeID])
+		{
+			marked[nodeID] = true;
+			nodes.push_back(nodeID);
+
+			if (nodeID == 0)
+				break;		// the root is its own parent
+			nodeID = TerrainQuadTree::parentIndex(nodeID);
+		}
+	}
+
+	// branches before the nodes they belong to (branches have the higher IDs)
+	sort(nodes.begin(), nodes.end(), greater<unsigned int>());
+	for(size_t i=0; i<nodes.size(); i++)
+		updateNodeBounds(nodes[i]);
+}
+
+// the leaves whose points overlap the points [x0, x1] x [z0, z1]
+void QTTerrain::findEditedLeaves(unsigned int nodeID, int x0, int z0, int x1, int z1, vector<unsigned int> &leaves)
+{
+	const TERRAINQUADTREENODE &node = terrainQT->qtNodeArray[nodeID];
+	if ((node.lastVertex.x < x0) || (node.firstVertex.x > x1) ||
+			(node.lastVertex.z < z0) || (node.firstVertex.z > z1))
+		return;
+
+	if (node.nodeType == QT_LEAF)
+	{
+		leaves.push_back(nodeID);
+		return;
+	}
+
+	for(int i=0; i<4; i++)
+		findEditedLeaves(TerrainQuadTree::branchIndex(nodeID, i), x0, z0, x1, z1, leaves);
+}
+
+// the height range of a node: a leaf from its points, other nodes from their branches
+// (which must be up to date), position.y is the middle of the range
+void QTTerrain::updateNodeBounds(unsigned int nodeID)
+{
+	TERRAINQUADTREENODE &node = terrainQT->qtNodeArray[nodeID];
+	int x0 = node.firstVertex.x, x1 = node.lastVertex.x;
+	int z0 = node.firstVertex.z, z1 = node.lastVertex.z;
+
+	if (node.nodeType != QT_LEAF)
+		terrainQT->mergeBranchBounds(nodeID);
+	else if (streaming)
+	{
+		// the ranges of the tiles under the leaf, so that no tile is read
+		heightField.getTileCache()->getSampleRange(x0, z0, x1, z1, node.minHeight, node.maxHeight);
+		node.minHeight *= scaleHeight;
+		node.maxHeight *= scaleHeight;
+	}
+	else
+	{
+		node.minHeight = node.maxHeight = terrainHeights[x0][z0];
+		for(int x=x0; x<=x1; x++)
+		{
+			for(int z=z0; z<=z1; z++)
+			{
+				node.minHeight = min(node.minHeight, terrainHeights[x][z]);
+				node.maxHeight = max(node.maxHeight, terrainHeights[x][z]);
+			}
+		}
+	}
+
+	terrainQT->qtNodeData[nodeID].position.y = (node.minHeight + node.maxHeight) / 2;
+}
+
+// the height range of every node, bottom-up
+void QTTerrain::buildNodeBounds()
+{
+	for(int i=(int)terrainQT->nodeSize-1; i>=0; i--)
+		updateNodeBounds(i);
+}
+
+// the two triangle planes of the cells [x0, x1) x [z0, z1), as slopes from point [x][z]
+// of each cell so that a height is a few multiply-adds (see distanceToPlane)
+void QTTerrain::calculateCellPlanes(int x0, int z0, int x1, int z1)
+{
+	workers.parallelFor(x0, x1, [this, z0, z1](int r0, int r1)
+	{
+		for(int x=r0; x<r1; x++)
+			for(int z=z0; z<z1; z++)
+				cellPlanes[x][z] = makeCellPlanes(x, z);
+	}, 16);
+}
+
+CELLPLANES QTTerrain::makeCellPlanes(int x, int z) const
+{
+	CELLPLANES cell;
+	float invScale = 1.0f / terrainScale;
+
+	// the last row and column share the padding like vertex()
+	float h00 = height(x, z), h01 = height(x, z+1);
+	float h10 = height(x+1, z), h11 = height(x+1, z+1);
+
+	cell.top.slopeX = (h10 - h00) * invScale;
+	cell.top.slopeZ = (h01 - h00) * invScale;
+	cell.top.height0 = h00;
+
+	cell.bottom.slopeX = (h11 - h01) * invScale;
+	cell.bottom.slopeZ = (h11 - h10) * invScale;
+	cell.bottom.height0 = h11 - (cell.bottom.slopeX + cell.bottom.slopeZ) * terrainScale;
+
+	// the unit normal of a plane y = sx * x + sz * z is (-sx, 1, -sz) normalised
+	cell.top.normalY = 1.0f / sqrtf(1.0f + cell.top.slopeX*cell.top.slopeX + cell.top.slopeZ*cell.top.slopeZ);
+	cell.bottom.normalY = 1.0f / sqrtf(1.0f + cell.bottom.slopeX*cell.bottom.slopeX + cell.bottom.slopeZ*cell.bottom.slopeZ);
+	return cell;
+}
+
+// the height of the triangle plane under pos, and the y of its unit normal
+float QTTerrain::planeHeight(const Vector3f &pos, float &normalY) const
+{
+	// clamped to the points like HeightKernel: the last point of a row or column
+	// belongs to the cell before it, so the zero padding is never read
+	float gx = min(max((pos.x + adjFromOrig) / terrainScale, 0.0f), (float)(dWidth - 1));
+	float gz = min(max((pos.z + adjFromOrig) / terrainScale, 0.0f), (float)(dHeight - 1));
+	int inX = min((int)gx, dWidth - 2);
+	int inZ = min((int)gz, dHeight - 2);
+
+	// offsets from point [x][z] of the cell
+	float dx = (gx - inX) * terrainScale;
+	float dz = (gz - inZ) * terrainScale;
+
+	// the top triangle is the side of the diagonal holding point [x][z]
+	const CELLPLANES &cell = cellPlanes[inX][inZ];
+	const CELLPLANE &plane = (dx + dz < terrainScale) ? cell.top : cell.bottom;
+
+	normalY = plane.normalY;
+	return plane.height0 + plane.slopeX * dx + plane.slopeZ * dz;
+}
+
+bool QTTerrain::rayCast(const Vector3f &origin, const Vector3f &direction, float maxDistance, RAYHIT &hit) const
+{
+	return traceRay(origin, direction, maxDistance, false, hit);
+}
+
+// the quadtree descent of rayCast and lineOfSight, anyHit stops at the first hit found
+// (which need not be the nearest) when only whether there is a hit matters
+bool QTTerrain::traceRay(Vector3f origin, Vector3f direction, float maxDistance, bool anyHit, RAYHIT &hit) const
+{
+	hit.hit = false;
+
+	// distances along a unit direction are world distances
+	float length = direction.magnitude();
+	if (length == 0.0f)
+		return false;
+	direction = direction / length;
+
+	// nodes are visited nearest first, a node beyond the nearest hit so far is skipped
+	struct RAYNODE { unsigned int ID; float tEnter, tExit; };
+	RAYNODE stack[4 * 32];
+	int top = 0;
+
+	const TERRAINQUADTREENODE *nodes = terrainQT->qtNodeArray;
+	float tEnter, tExit;
+	if (!rayBox(nodes[0], origin, direction, maxDistance, tEnter, tExit))
+		return false;
+	stack[top].ID = 0;
+	stack[top].tEnter = tEnter;
+	stack[top++].tExit = tExit;
+
+	while (top > 0)
+	{
+		RAYNODE entry = stack[--top];
+		if (hit.hit && (entry.tEnter >= hit.distance))
+			continue;
+
+		const TERRAINQUADTREENODE &node = nodes[entry.ID];
+		if (node.nodeType == QT_LEAF)
+		{
+			RAYHIT leafHit;
+			if (rayLeaf(node, origin, direction, entry.tEnter, entry.tExit, leafHit) &&
+					(!hit.hit || (leafHit.distance < hit.distance)))
+			{
+				hit = leafHit;
+				if (anyHit)
+					break;
+			}
+			continue;
+		}
+
+		// push the branches the ray passes through, farthest first so that the nearest is popped first
+		RAYNODE branches[4];
+		int count = 0;
+		for(int i=0; i<4; i++)
+		{
+			if (!rayBox(nodes[TerrainQuadTree::branchIndex(entry.ID, i)], origin, direction, maxDistance, tEnter, tExit))
+				continue;
+
+			int j = count++;
+			while ((j > 0) && (branches[j-1].tEnter < tEnter))
+			{
+				branches[j] = branches[j-1];
+				j--;
+			}
+			branches[j].ID = TerrainQuadTree::branchIndex(entry.ID, i);
+			branches[j].tEnter = tEnter;
+			branches[j].tExit = tExit;
+		}
+		for(int i=0; i<count; i++)
+			stack[top++] = branches[i];
+	}
+
+	return hit.hit;
+}
+
+void QTTerrain::rayCast(const Vector3f *origins, const Vector3f *directions, size_t n, float maxDistance, RAYHIT *hits)
+{
+	workers.parallelFor(0, (int)n, [this, origins, directions, maxDistance, hits](int i0, int i1)
+	{
+		for(int i=i0; i<i1; i++)
+			rayCast(origins[i], directions[i], maxDistance, hits[i]);
+	}, 64);
+}
+
+bool QTTerrain::lineOfSight(const Vector3f &from, const Vector3f &to) const
+{
+	// a node whose box the segment misses (such as a valley under it) is not descended
+	Vector3f direction = to - from;
+	float length = direction.magnitude();
+	if (length == 0.0f)
+		return true;
+
+	RAYHIT hit;
+	return !traceRay(from, direction, length, true, hit);
+}
+
+void QTTerrain::lineOfSight(const Vector3f *from, const Vector3f *to, size_t n, bool *visible) const
+{
+	vector<uint64_t> keys(n);
+	for(size_t i=0; i<n; i++)
+	{
+		int x0, z0, x1, z1;
+		posToArrayIndex(from[i], x0, z0);
+		posToArrayIndex(to[i], x1, z1);
+		uint64_t cell0 = (uint64_t)min(max(x0, 0), dWidth-1) * dHeight + min(max(z0, 0), dHeight-1);
+		uint64_t cell1 = (uint64_t)min(max(x1, 0), dWidth-1) * dHeight + min(max(z1, 0), dHeight-1);
+		keys[i] = (cell0 << 32) | cell1;
+	}
+
+	// queries answered this frame, or earlier in this batch, are not traced again
+	vector<size_t> traced;
+	unordered_map<uint64_t, size_t> batchQueries;
+	{
+		lock_guard<mutex> guard(sightLock);
+		for(size_t i=0; i<n; i++)
+		{
+			unordered_map<uint64_t, bool>::const_iterator answer = sightCache.find(keys[i]);
+			if (answer != sightCache.end())
+				visible[i] = answer->second;
+			else if (batchQueries.insert(make_pair(keys[i], i)).second)
+				traced.push_back(i);
+		}
+	}
+
+	// traced on the calling thread, agents updated on several threads each trace their own
+	for(size_t j=0; j<traced.size(); j++)
+		visible[traced[j]] = lineOfSight(from[traced[j]], to[traced[j]]);
+
+	lock_guard<mutex> guard(sightLock);
+	for(size_t i=0; i<n; i++)
+	{
+		unordered_map<uint64_t, size_t>::const_iterator query = batchQueries.find(keys[i]);
+		if (query == batchQueries.end())
+			continue;
+		visible[i] = visible[query->second];
+		sightCache[keys[i]] = visible[i];
+	}
+}
+
+// the part [tEnter, tExit] of the ray (t from 0 to maxDistance) inside the box of a node,
+// the box spans the points of the node and its height range
+bool QTTerrain::rayBox(const TERRAINQUADTREENODE &node, Vector3f origin, Vector3f direction, float maxDistance,
+											 float &tEnter, float &tExit) const
+{
+	float boxMin[3] = { node.firstVertex.x * terrainScale - adjFromOrig, node.minHeight,
+											node.firstVertex.z * terrainScale - adjFromOrig };
+	float boxMax[3] = { node.lastVertex.x * terrainScale - adjFromOrig, node.maxHeight,
+											node.lastVertex.z * terrainScale - adjFromOrig };
+	float o[3] = { origin.x, origin.y, origin.z };
+	float d[3] = { direction.x, direction.y, direction.z };
+
+	tEnter = 0.0f;
+	tExit = maxDistance;
+	for(int axis=0; axis<3; axis++)
+	{
+		if (d[axis] == 0.0f)
+		{
+			// parallel to the slab, inside it or never
+			if ((o[axis] < boxMin[axis]) || (o[axis] > boxMax[axis]))
+				return false;
+			continue;
+		}
+
+		float t0 = (boxMin[axis] - o[axis]) / d[axis];
+		float t1 = (boxMax[axis] - o[axis]) / d[axis];
+		if (t0 > t1)
+			swap(t0, t1);
+
+		tEnter = max(tEnter, t0);
+		tExit = min(tExit, t1);
+		if (tEnter > tExit)
 			return false;
+	}
+	return true;
+}
+
+// walk the cells of a leaf along the ray (a 2D DDA in x and z) from tEnter to tExit
+bool QTTerrain::rayLeaf(const TERRAINQUADTREENODE &node, Vector3f origin, Vector3f direction, float tEnter, float tExit, RAYHIT &hit) const
+{
+	// the cells of the leaf are [x0, x1) x [z0, z1)
+	int x0 = node.firstVertex.x, x1 = node.lastVertex.x;
+	int z0 = node.firstVertex.z, z1 = node.lastVertex.z;
+
+	// the cell holding the entry point
+	float gx = (origin.x + direction.x * tEnter + adjFromOrig) / terrainScale;
+	float gz = (origin.z + direction.z * tEnter + adjFromOrig) / terrainScale;
+	int x = min(max((int)floor(gx), x0), x1 - 1);
+	int z = min(max((int)floor(gz), z0), z1 - 1);
+
+	// t of the next cell boundary in x and z, and t between boundaries
+	int stepX = (direction.x > 0.0f) ? 1 : -1;
+	int stepZ = (direction.z > 0.0f) ? 1 : -1;
+	float tNextX = FLT_MAX, tNextZ = FLT_MAX;
+	float tDeltaX = FLT_MAX, tDeltaZ = FLT_MAX;
+	if (direction.x != 0.0f)
+	{
+		float boundX = (x + ((stepX > 0) ? 1 : 0)) * terrainScale - adjFromOrig;
+		tNextX = (boundX - origin.x) / direction.x;
+		tDeltaX = terrainScale / fabs(direction.x);
+	}
+	if (direction.z != 0.0f)
+	{
+		float boundZ = (z + ((stepZ > 0) ? 1 : 0)) * terrainScale - adjFromOrig;
+		tNextZ = (boundZ - origin.z) / direction.z;
+		tDeltaZ = terrainScale / fabs(direction.z);
+	}
+
+	float t = tEnter;
+	while (t <= tExit)
+	{
+		float tCellExit = min(min(tNextX, tNextZ), tExit);
+		if (rayCell(x, z, origin, direction, t, tCellExit, hit))
+			return true;
+
+		// step into the neighbouring cell through the nearer boundary
+		if (tNextX < tNextZ)
+		{
+			x += stepX;
+			t = tNextX;
+			tNextX += tDeltaX;
+		}
+		else
+		{
+			z += stepZ;
+			t = tNextZ;
+			tNextZ += tDeltaZ;
+		}
+
+		if ((x < x0) || (x >= x1) || (z < z0) || (z >= z1) || (tCellExit >= tExit))
+			break;
+	}
+	return false;
 }
 
-float QTTerrain::distanceToPlane(Vector3f pos)
+// the nearer hit of the two triangles of cell [x][z] between tEnter and tExit
+bool QTTerrain::rayCell(int x, int z, Vector3f origin, Vector3f direction, float tEnter, float tExit, RAYHIT &hit) const
 {
+	CELLPLANES cell = (cellPlanes.getWidth() > 0) ? cellPlanes[x][z] : makeCellPlanes(x, z);
+	const CELLPLANE *planes[2] = { &cell.top, &cell.bottom };
+
+	// offsets of the origin from point [x][z] of the cell
+	float dx = origin.x - (x*terrainScale - adjFromOrig);
+	float dz = origin.z - (z*terrainScale - adjFromOrig);
+
+	// a small margin so that a hit on a cell edge is not lost between two cells
+	float margin = terrainScale * 1e-4f;
+
+	hit.hit = false;
+	for(int i=0; i<2; i++)
+	{
+		// the height of the ray above the plane is a + b * t
+		const CELLPLANE &plane = *planes[i];
+		float a = origin.y - (plane.height0 + plane.slopeX * dx + plane.slopeZ * dz);
+		float b = direction.y - plane.slopeX * direction.x - plane.slopeZ * direction.z;
+		if (b == 0.0f)
+			continue;
+
+		float t = -a / b;
+		if ((t < tEnter - margin) || (t > tExit + margin) || (hit.hit && (t >= hit.distance)))
+			continue;
+
+		// the top triangle is the side of the diagonal holding point [x][z]
+		float side = (dx + direction.x * t) + (dz + direction.z * t) - terrainScale;
+		if ((i == 0) ? (side > margin) : (side < -margin))
+			continue;
+
+		hit.hit = true;
+		hit.distance = max(t, 0.0f);
+		hit.point = origin + direction * hit.distance;
+		hit.normal = Vector3f(-plane.slopeX, 1.0f, -plane.slopeZ) * plane.normalY;
+		hit.cellX = x;
+		hit.cellZ = z;
+	}
+	return hit.hit;
+}
+
+float QTTerrain::distanceToPlane(const Vector3f &pos) const
+{
+	// the height above the plane, projected on its normal
+	if (cellPlanes.getWidth() > 0)
+	{
+		float normalY;
+		float h = planeHeight(pos, normalY);
+		return (pos.y - h) * normalY;
+	}
+
 	// plane equation = ax + by + cz + d = 0
 	float dist = 0.0f;
 
@@ -547,42 +1421,53 @@ float QTTerrain::distanceToPlane(Vector3f pos)
   Vector3f faceNormal;
 
 	posToArrayIndex(pos, inX, inZ);
-	// cout<<"CELL["<<inX<<"]["<<inZ<<"] T:"<<cellinfo[inX][inZ].top<<" B:"<<cellinfo[inX][inZ].bottom<<" L:"<<cellinfo[inX][inZ].left<<" R:"<<cellinfo[inX][inZ].right<<endl;
+
+	// the last point of a row or column belongs to the cell before it and past the
+	// points the surface is level (as in HeightKernel and planeHeight)
+	inX = min(max(inX, 0), dWidth - 2);
+	inZ = min(max(inZ, 0), dHeight - 2);
+	Vector3f onGrid = pos;
+	onGrid.x = min(max(pos.x, -adjFromOrig), (dWidth - 1) * terrainScale - adjFromOrig);
+	onGrid.z = min(max(pos.z, -adjFromOrig), (dHeight - 1) * terrainScale - adjFromOrig);
+	// cout<<"CELL["<<inX<<"]["<<inZ<<"] T:"<<cellBounds(inX, inZ).top<<" B:"<<cellBounds(inX, inZ).bottom<<" L:"<<cellBounds(inX, inZ).left<<" R:"<<cellBounds(inX, inZ).right<<endl;
+
+  // the 4 corners of the cell
+  Vector3f p00 = vertex(inX, inZ);
+  Vector3f p01 = vertex(inX, inZ+1);
+  Vector3f p10 = vertex(inX+1, inZ);
+  Vector3f p11 = vertex(inX+1, inZ+1);
 
   // // which triangle on a plane is the pos on?
-  bool isAbove = Vector3f::isAboveLine(
-    Vector3f(terrainData[inX][inZ+1].x, terrainData[inX][inZ+1].y, terrainData[inX][inZ+1].z),
-    Vector3f(terrainData[inX+1][inZ].x, terrainData[inX+1][inZ].y, terrainData[inX+1][inZ].z),
-    pos);
+  bool isAbove = Vector3f::isAboveLine(p01, p10, onGrid);
 
   float D;
   if(isAbove) // top triangle
   {
 	  // calculate the normals for the top pair of triangle
-    faceNormal = calculateFaceNormal(terrainData[inX][inZ], terrainData[inX][inZ+1], terrainData[inX+1][inZ]);
+    faceNormal = calculateFaceNormal(p00, p01, p10);
 
     // dot product of plane normal and plane position
-  	D = faceNormal.dotProduct(terrainData[inX][inZ]);
+  	D = faceNormal.dotProduct(p00);
     //faceNormal.print();
   }
   else  // bottom triangle
   {
-    faceNormal = calculateFaceNormal(terrainData[inX+1][inZ+1], terrainData[inX+1][inZ], terrainData[inX][inZ+1]);
+    faceNormal = calculateFaceNormal(p11, p10, p01);
     //faceNormal = calculateFaceNormal(terrainData[inX+1][inZ], terrainData[inX][inZ+1], terrainData[inX+1][inZ+1]);
 
     // dot product of plane normal and plane position
-  	D = faceNormal.dotProduct(terrainData[inX+1][inZ+1]);
+  	D = faceNormal.dotProduct(p11);
   }
 	// cout<<"D of plane:"<<D<<endl;
 
 	// test the pos against the plane normals
-	dist = faceNormal.dotProduct(pos) - D;
+	dist = faceNormal.dotProduct(onGrid) - D;
 	// cout<<"The cube in relation to the plane is:"<<dist<<endl;
 
 	return  dist;
 }
 
-Vector3f QTTerrain::calculateFaceNormal(Vector3f p0, Vector3f p1, Vector3f p2)
+Vector3f QTTerrain::calculateFaceNormal(Vector3f p0, Vector3f p1, Vector3f p2) const
 {
 	// ------------------------------------------------ calculate normals
 
@@ -601,22 +1486,141 @@ Vector3f QTTerrain::calculateFaceNormal(Vector3f p0, Vector3f p1, Vector3f p2)
 }
 
 void QTTerrain::calculateNormals(int flag)
+{
+	if(flag == NORMAL_FLAT)
+		cout<<">> Calculating Terrain Normals: FLAT..."<<endl;
+	else if (flag == NORMAL_SMOOTH)
+		cout<<">> Calculating Terrain Normals: SMOOTH..."<<endl;
+	else if (flag == NORMAL_CENTRAL)
+		cout<<">> Calculating Terrain Normals: CENTRAL ("<<normalKernelISA()<<")..."<<endl;
+
+	// each vertex normal only depends on the terrain points, rows are shared by the thread pool
+	workers.parallelFor(0, dWidth, [this, flag](int x0, int x1)
+	{
+		if (flag == NORMAL_CENTRAL)
+			calculateCentralNormalRows(x0, x1, 0, dHeight, true);
+		else
+			calculateNormalRows(flag, x0, x1, 0, dHeight);
+	});
+	cout<<">> Terrain Normals calculated successfully"<<endl;
+}
+
+// the normals of the rows x0 to x1-1 (points z0 to z1-1 of each) by central differences
+// of the heights, the edge rows and columns are repeated so the kernel needs no border cases
+void QTTerrain::calculateCentralNormalRows(int x0, int x1, int z0, int z1, bool vectorised)
+{
+	int length = z1 - z0;
+	vector<float> centre(length + 2);		// this part of the row padded by one height at each end
+	vector<Vector3f> row(length);
+	float twoSpacing = 2.0f * terrainScale;
+
+	for(int x=x0; x<x1; x++)
+	{
+		const float *up = terrainHeights[(x > 0) ? x-1 : 0] + z0;
+		const float *down = terrainHeights[(x < dWidth-1) ? x+1 : dWidth-1] + z0;
+
+		centre[0] = terrainHeights[x][(z0 > 0) ? z0-1 : 0];
+		memcpy(&centre[1], terrainHeights[x] + z0, sizeof(float) * length);
+		centre[length+1] = terrainHeights[x][(z1 < dHeight) ? z1 : dHeight-1];
+
+		// encoded normals are computed into a row first
+		Vector3f *normals = terrainNormals.getFloat3Row(x);
+		if (normals == NULL)
+			normals = &row[0];
+		else
+			normals += z0;
+
+		if (vectorised)
+			computeNormalRow(up, &centre[0], down, twoSpacing, normals, length);
+		else
+			computeNormalRowScalar(up, &centre[0], down, twoSpacing, normals, length);
+
+		if (normals == &row[0])
+			terrainNormals.setRow(x, z0, length, normals);
+	}
+}
+
+// time the normal generators and measure how far the central difference normals
+// are from the NORMAL_SMOOTH ones, the normals in use are kept
+void QTTerrain::compareNormals()
+{
+	if (streaming)
+	{
+		cout<<">> Streaming terrain: normals are computed per vertex"<<endl;
+		return;
+	}
+
+	size_t count = (size_t)dWidth * dHeight;
+	Array2D<Vector3f> smooth(dWidth, dHeight);
+	Array2D<Vector3f> scalar(dWidth, dHeight);
+
+	// the generators are timed on NORMALS_FLOAT3, the normals in use are put aside
+	// (the new buffer starts at zero, NORMAL_SMOOTH does not write every border normal)
+	NormalBuffer inUse;
+	inUse.swap(terrainNormals);
+	terrainNormals.allocate(dWidth, dHeight, NORMALS_FLOAT3);
+	const Vector3f *normals = terrainNormals.getFloat3Row(0);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	calculateNormals(NORMAL_SMOOTH);
+	double smoothMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	copy(normals, normals + count, smooth.getData());
+
+	start = chrono::steady_clock::now();
+	workers.parallelFor(0, dWidth, [this](int x0, int x1) { calculateCentralNormalRows(x0, x1, 0, dHeight, false); });
+	double scalarMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	copy(normals, normals + count, scalar.getData());
+
+	start = chrono::steady_clock::now();
+	workers.parallelFor(0, dWidth, [this](int x0, int x1) { calculateCentralNormalRows(x0, x1, 0, dHeight, true); });
+	double simdMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	// NORMAL_SMOOTH leaves some border normals at zero, those are skipped
+	double sumAngle = 0.0, maxAngle = 0.0, maxKernelDiff = 0.0;
+	size_t compared = 0;
+	for(size_t i=0; i<count; i++)
+	{
+		Vector3f n = normals[i];
+		Vector3f s = scalar.getData()[i];
+		maxKernelDiff = max(maxKernelDiff, (double)max(fabs(n.x - s.x), max(fabs(n.y - s.y), fabs(n.z - s.z))));
+
+		Vector3f r = smooth.getData()[i];
+		if (r.magnitude() == 0.0f)
+			continue;
+
+		double angle = acos(max(-1.0f, min(1.0f, n.dotProduct(r)))) * (180.0 / PI);
+		sumAngle += angle;
+		maxAngle = max(maxAngle, angle);
+		compared++;
+	}
+
+	terrainNormals.swap(inUse);
+
+	cout<<">> Normals on "<<dWidth<<"x"<<dHeight<<" ("<<workers.getThreadCount()<<" threads)"<<endl;
+	cout<<"   SMOOTH: "<<smoothMs<<" ms"<<endl;
+	cout<<"   CENTRAL scalar: "<<scalarMs<<" ms"<<endl;
+	cout<<"   CENTRAL "<<normalKernelISA()<<": "<<simdMs<<" ms ("<<smoothMs / simdMs<<"x SMOOTH)"<<endl;
+	cout<<"   "<<normalKernelISA()<<" vs scalar max difference: "<<maxKernelDiff<<endl;
+	cout<<"   CENTRAL vs SMOOTH angle: mean "<<((compared > 0) ? sumAngle / compared : 0.0)<<" max "<<maxAngle
+			<<" degrees ("<<compared<<" vertices, "<<count - compared<<" SMOOTH border vertices skipped)"<<endl;
+}
+
+// the normals of the rows x0 to x1-1 (points z0 to z1-1 of each)
+void QTTerrain::calculateNormalRows(int flag, int x0, int x1, int z0, int z1)
 {
 	Vector3f vN;	// the normal vector for each vertex
 
 	if(flag == NORMAL_FLAT)
 	{
-		cout<<">> Calculating Terrain Normals: FLAT..."<<endl;
-
 		// loop through all vertices
-		for(int x=0; x < dWidth; x++)		// x
+		for(int x=x0; x < x1; x++)		// x
 		{
-			for(int z=0; z<dWidth; z++)	// z
+			for(int z=z0; z<z1; z++)	// z
 			{
 				// get the 3 points for computing the 2 vectors
-				Vector3f p0 = Vector3f(terrainData[x][z].x, terrainData[x][z].y, terrainData[x][z].z);			// original point
-				Vector3f p1 = Vector3f(terrainData[x+1][z].x, terrainData[x+1][z].y, terrainData[x+1][z].z);	// the x line
-				Vector3f p2 = Vector3f(terrainData[x][z+1].x, terrainData[x][z+1].y, terrainData[x][z+1].z);	// the z line
+				Vector3f p0 = vertex(x, z);			// original point
+				Vector3f p1 = vertex(x+1, z);	// the x line
+				Vector3f p2 = vertex(x, z+1);	// the z line
 
 				// compute the 2 vectors
 				Vector3f vA = p1 - p0;	// x line vector
@@ -631,29 +1635,28 @@ void QTTerrain::calculateNormals(int flag)
 				//cout<<"vN:"<<vN.x<<" "<<vN.y<<" "<<vN.z<<endl;
 
 				// assign the normal to terrainNormal array
-				terrainNormals[x][z] = vN;
+				terrainNormals.set(x, z, vN);
 			}
 		}
 	}
 	else if (flag == NORMAL_SMOOTH)
 	{
 		/**** Calculate Average of 4 quad normals for the vertex ****/
-		cout<<">> Calculating Terrain Normals: SMOOTH..."<<endl;
 
 		// loop through all vertices
-		for(int x=0; x < dWidth; x++)			// x
+		for(int x=x0; x < x1; x++)			// x
 		{
-			for(int z=0; z<dHeight; z++)		// z
+			for(int z=z0; z<z1; z++)		// z
 			{
-				Vector3f pOr = Vector3f(terrainData[x][z].x, terrainData[x][z].y, terrainData[x][z].z);			// original point
+				Vector3f pOr = vertex(x, z);			// original point
 
 				if ((x==0) && (z==0))	// origin (upper left)
 				{
 					// only East and South Point is computed
 					//cout<<"Origin: x="<<x<<" z="<<z<<endl;
 
-					Vector3f pE = Vector3f(terrainData[x+1][z].x, terrainData[x+1][z].y, terrainData[x+1][z].z);		// east point
-					Vector3f pS = Vector3f(terrainData[x][z+1].x, terrainData[x][z+1].y, terrainData[x][z+1].z);		// south point
+					Vector3f pE = vertex(x+1, z);		// east point
+					Vector3f pS = vertex(x, z+1);		// south point
 
 					// compute the 2 vectors
 					Vector3f vE =	pE - pOr;	// east vector
@@ -668,7 +1671,7 @@ void QTTerrain::calculateNormals(int flag)
 					//cout<<"vN:"<<vN.x<<" "<<vN.y<<" "<<vN.z<<endl;
 
 					// assign the normal to terrainNormal array
-					terrainNormals[x][z] = -vN;
+					terrainNormals.set(x, z, -vN);
 
 				}
 				else if((x==0) && (z==dHeight))	// bottom left
@@ -676,8 +1679,8 @@ void QTTerrain::calculateNormals(int flag)
 					// only North and East Point
 					//cout<<"Bottom Left: x="<<x<<" z="<<z<<endl;
 
-					Vector3f pN = Vector3f(terrainData[x][z-1].x, terrainData[x][z-1].y, terrainData[x][z-1].z);		// north point
-					Vector3f pE = Vector3f(terrainData[x+1][z].x, terrainData[x+1][z].y, terrainData[x+1][z].z);		// east point
+					Vector3f pN = vertex(x, z-1);		// north point
+					Vector3f pE = vertex(x+1, z);		// east point
 
 					// compute the 2 vectors
 					Vector3f vE =	pE - pOr;		// east vector
@@ -690,7 +1693,7 @@ void QTTerrain::calculateNormals(int flag)
 					vN.normalise();
 
 					// assign the normal to terrainNormal array
-					terrainNormals[x][z] = -vN;
+					terrainNormals.set(x, z, -vN);
 
 				}
 				else if((x==dWidth) && (z==0))	// upper right
@@ -698,8 +1701,8 @@ void QTTerrain::calculateNormals(int flag)
 					// only compute west and south vector
 					//cout<<"Upper Right: x="<<x<<" z="<<z<<endl;
 
-					Vector3f pS = Vector3f(terrainData[x][z+1].x, terrainData[x][z+1].y, terrainData[x][z+1].z);		// south point
-					Vector3f pW = Vector3f(terrainData[x-1][z].x, terrainData[x-1][z].y, terrainData[x-1][z].z);		// east point
+					Vector3f pS = vertex(x, z+1);		// south point
+					Vector3f pW = vertex(x-1, z);		// east point
 
 					// compute the 2 vectors
 					Vector3f vW = pW - pOr;	// west vector
@@ -712,7 +1715,7 @@ void QTTerrain::calculateNormals(int flag)
 					vN.normalise();
 
 					// assign the normal to terrainNormal array
-					terrainNormals[x][z] = -vN;
+					terrainNormals.set(x, z, -vN);
 
 				}
 				else	if((x==dWidth) && (z==dHeight))	// bottom right
@@ -720,8 +1723,8 @@ void QTTerrain::calculateNormals(int flag)
 					// only the north and west vector
 					//cout<<"Bottom Right: x="<<x<<" z="<<z<<endl;
 
-					Vector3f pN = Vector3f(terrainData[x][z-1].x, terrainData[x][z-1].y, terrainData[x][z-1].z);		// north point
-					Vector3f pW = Vector3f(terrainData[x-1][z].x, terrainData[x-1][z].y, terrainData[x-1][z].z);		// east point
+					Vector3f pN = vertex(x, z-1);		// north point
+					Vector3f pW = vertex(x-1, z);		// east point
 
 					// compute the 2 vectors
 					Vector3f vNr = pN - pOr;	// north vector
@@ -734,7 +1737,7 @@ void QTTerrain::calculateNormals(int flag)
 					vN.normalise();
 
 					// assign the normal to terrainNormal array
-					terrainNormals[x][z] = -vN;
+					terrainNormals.set(x, z, -vN);
 				}
 				else if ( (x==0) && ( (z>0) && (z<dHeight) ) )	// left cell span
 				{
@@ -742,8 +1745,8 @@ void QTTerrain::calculateNormals(int flag)
 					//cout<<"Left Cell Span: x="<<x<<" z="<<z<<endl;
 
 					// NE quadrant
-					Vector3f pN = Vector3f(terrainData[x][z-1].x, terrainData[x][z-1].y, terrainData[x][z-1].z);			// north point
-					Vector3f pNE = Vector3f(terrainData[x+1][z-1].x, terrainData[x+1][z-1].y, terrainData[x+1][z-1].z);	// NE point
+					Vector3f pN = vertex(x, z-1);			// north point
+					Vector3f pNE = vertex(x+1, z-1);	// NE point
 
 					Vector3f vTR = pNE - pN;	// top to the right vector (A - B is B points to A)
 					Vector3f vTB = pOr - pN;	// top to the bottom vector
@@ -751,8 +1754,8 @@ void QTTerrain::calculateNormals(int flag)
 					Vector3f vNENorm = vTR.crossProduct(vTB);
 
 					// SE quadrant
-					Vector3f pS = Vector3f(terrainData[x][z+1].x, terrainData[x][z+1].y, terrainData[x][z+1].z);	// south point
-					Vector3f pE = Vector3f(terrainData[x+1][z].x, terrainData[x+1][z].y, terrainData[x+1][z].z);	// east point
+					Vector3f pS = vertex(x, z+1);	// south point
+					Vector3f pE = vertex(x+1, z);	// east point
 
 					Vector3f vOR = pE - pOr;	// origin to right vector
 					Vector3f vOB = pS - pOr;	// origin to bottom vector
@@ -766,7 +1769,7 @@ void QTTerrain::calculateNormals(int flag)
 					vN.normalise();
 
 					// the vertex average normal is then assigned to the terrainNormals
-					terrainNormals[x][z] = -vN;
+					terrainNormals.set(x, z, -vN);
 
 				}
 				else if ( (x==dWidth-1) && ( (z>0) && (z<dHeight) ) )	// **right cell span
@@ -784,13 +1787,13 @@ void QTTerrain::calculateNormals(int flag)
 				else	// all centre cells
 				{
 					//cout<<"Centre Cells: x="<<x<<" z="<<z<<endl;
-					pOr = Vector3f(terrainData[x][z].x, terrainData[x][z].y, terrainData[x][z].z);			// original point
-					Vector3f pN = Vector3f(terrainData[x][z-1].x, terrainData[x][z-1].y, terrainData[x][z-1].z);			// north point
-					Vector3f pNE = Vector3f(terrainData[x+1][z].x, terrainData[x+1][z-1].y, terrainData[x+1][z-1].z);	// NE point
-					Vector3f pE = Vector3f(terrainData[x+1][z].x, terrainData[x+1][z].y, terrainData[x+1][z].z);		// east point
-					Vector3f pS = Vector3f(terrainData[x][z+1].x, terrainData[x][z+1].y, terrainData[x][z+1].z);		// south point
-					Vector3f pSW = Vector3f(terrainData[x-1][z+1].x, terrainData[x-1][z+1].y, terrainData[x-1][z+1].z);	// southwest point
-					Vector3f pW = Vector3f(terrainData[x-1][z].x, terrainData[x-1][z].y, terrainData[x-1][z].z);			// west point
+					pOr = vertex(x, z);			// original point
+					Vector3f pN = vertex(x, z-1);			// north point
+					Vector3f pNE = vertex(x+1, z-1);	// NE point
+					Vector3f pE = vertex(x+1, z);		// east point
+					Vector3f pS = vertex(x, z+1);		// south point
+					Vector3f pSW = vertex(x-1, z+1);	// southwest point
+					Vector3f pW = vertex(x-1, z);			// west point
 
 					// NE quadrant
 					Vector3f vO_N = pN - pOr;	// origin to northvector
@@ -833,14 +1836,12 @@ void QTTerrain::calculateNormals(int flag)
 					//vN.printVector();
 
 					// the vertex average normal is then assigned to the terrainNormals
-					terrainNormals[x][z] = -vN;
+					terrainNormals.set(x, z, -vN);
 				}
 
 			}
 		}
 
-		cout<<">> Terrain Normals calculated successfully"<<endl;
-
 	}
 
 
@@ -989,3 +1990,9 @@ void QTTerrain::setEdgeMode()
 	_edgemode = !_edgemode;
 	cout<<"edgemode: "<<_edgemode<<endl;
 }
+
+void QTTerrain::setFrustumCulling()
+{
+	_frustumCulling = !_frustumCulling;
+	cout<<"frustum culling: "<<_frustumCulling<<endl;
+}
@@ -16,7 +16,16 @@
 
 #include "OGLUtil.h"
 #include "typedefs.h"
+#include "Array2D.h"
+#include "NormalBuffer.h"
+#include "HeightMap.h"
 #include "TerrainQuadTree.h"
+#include "TerrainCache.h"
+#include "ThreadPool.h"
+#include "TerrainView.h"
+#include <chrono>
+#include <unordered_map>
+#include <mutex>
 
 // BMP-------------------------------------------------------------------- START
 #define BITMAP_ID	0x4D42	// the universal bitmap ID
@@ -47,20 +56,40 @@ typedef struct tagBITMAPFILEHEADER {
 } BITMAPFILEHEADER;
 // BMP---------------------------------------------------------------------- END
 
-// which cell is the current cell
-struct CELLINFO
+// a triangle of a cell as a height plane: height = height0 + slopeX * dx + slopeZ * dz,
+// dx and dz being the world offsets from point [x][z] of the cell. normalY (the y of the
+// unit normal) turns a height above the plane into the distance to the plane
+struct CELLPLANE
 {
-	float top;
-	float bottom;
-	float left;
-	float right;
+	float slopeX, slopeZ;
+	float height0;
+	float normalY;
 };
 
+// the two triangles of cell [x][z], split by the diagonal from [x][z+1] to [x+1][z]
+struct CELLPLANES
+{
+	CELLPLANE top;			// holding point [x][z]
+	CELLPLANE bottom;		// holding point [x+1][z+1]
+};
+
+// how single height queries (getHeight, distanceToPlane) find the surface
+// HEIGHTS_FROM_POINTS builds the triangle plane from the terrain points every query
+// HEIGHTS_FROM_PLANES reads it from a table of CELLPLANES (32 bytes per point)
+// both give the same heights, only the memory and the time of a query differ
+enum HEIGHTLOOKUP { HEIGHTS_FROM_POINTS, HEIGHTS_FROM_PLANES };
+
 // for shading and normals calculation
-enum { NORMAL_FLAT, NORMAL_SMOOTH };
+// NORMAL_CENTRAL is smooth shading from central differences, vectorised (NormalKernel.h)
+enum { NORMAL_FLAT, NORMAL_SMOOTH, NORMAL_CENTRAL };
+
+// the quadtree gets as many levels as needed for leaves of at most this many cells
+// across (a 512 terrain has 7 levels, 4096 has 10), up to QT_MAX_LEVELS (16384 has
+// 11 levels of 16 cell leaves)
+#define QTTERRAIN_LEAF_CELLS	8
 
 /****************************** PROTOTYPES ******************************/
-class QTTerrain
+class QTTerrain: public TerrainView
 {
 private:
 
@@ -81,26 +110,35 @@ private:
 
   bool _wireFrame;
   bool _edgemode;
+  bool _frustumCulling;			// cull the quadtree to the view frustum when render is given a view-projection
 
 
 	// ---------------------------------------------------------------------------
 
 	// RAW INFO
 	// ---------------------------------------------------------------------------
-	uint8_t heightField[512][512];		// the size of the heightfield[x][y]
-	Vector3f terrainNormals[512][512];	// the terrain normals for each point 32*32=1024
+	// sized at construction from width and length ([x][z])
+	HeightMap heightField;		// the heightfield samples, mapped from the RAW file
+	Array2D<float> terrainHeights;		// the terrain height of each point, padded by 2 rows and cols
+	NormalBuffer terrainNormals;	// the terrain normals for each point (NORMALSTORAGE)
+	int normalStorage;						// float3, oct16 or oct8, chosen at construction
+	Array2D<CELLPLANES> cellPlanes;	// the triangle planes of each cell (HEIGHTS_FROM_PLANES only)
+	int heightLookup;							// HEIGHTLOOKUP, chosen at construction
+	mutable unordered_map<uint64_t, bool> sightCache;	// line of sight answers of this frame, by cell pair
+	mutable mutex sightLock;			// guards sightCache, the view is shared by threads
+	Array2D<TERRAINGRADIENT> terrainGradients;	// the gradient at each point, from terrainNormals
 	//Vector3f **terrainNormals;
 
-	CELLINFO cellinfo[512][512];		// each polygon (quad) is a cell (this is its boundary)
 	CELLINFO boundary;			// boundary of the entire terrain (2D bounding box)
 
-	FILE *theFile;					// handle for the the raw file
-	float scaleHeight;			// height scaling factor of terrain
+	float scaleHeight;			// world height of a heightField sample of 1.0
 	float terrainScale;			// scaling size for terrain
 	float adjFromOrig;			// adjustment variable to set terrain centre at origin
 
 	int dWidth, dHeight;		// width and height of terrain (how many pixels)
 	float viewRange;				// viewing range of quadtree LOD nodes
+	bool streaming;					// heightField is a tiled file, the derived arrays are not built
+	vector<int> tileRequests;	// tiles under the visible nodes (reused every frame)
 
 	// ---------------------------------------------------------------------------
   // Matrix for the terrain
@@ -108,12 +146,79 @@ private:
 	Matrix4x4 matRot;
 	Vector3f 	vPos;
 
+	void createTerrain(const char *sourceFilename, float spacing, float heightScale, int _normalsFlag);	// build from the loaded heightField (sourceFilename is NULL when generated)
+
+	// precomputed terrain saved next to the heightmap (<heightmap>.qtc)
+	void describeCache(const char *sourceFilename, TERRAINCACHEHEADER &cacheInfo);
+	unsigned int quadTreeLevels() const;		// levels of the quadtree for this terrain size
+	bool loadCache(const char *cacheFilename, const TERRAINCACHEHEADER &cacheInfo);
+	void saveCache(const char *cacheFilename, TERRAINCACHEHEADER &cacheInfo);
+
+	// startup preprocessing runs its row loops on a thread pool
+	ThreadPool workers;
+	void calculateNormalRows(int flag, int x0, int x1, int z0, int z1);
+	void calculateCentralNormalRows(int x0, int x1, int z0, int z1, bool vectorised);
+
+	// terrain edits refresh the normals and quadtree nodes around the edited points
+	void refreshNormals(int x0, int z0, int x1, int z1);
+	void refreshNodes(int x0, int z0, int x1, int z1);
+	void findEditedLeaves(unsigned int nodeID, int x0, int z0, int x1, int z1, vector<unsigned int> &leaves);
+	void updateNodeBounds(unsigned int nodeID);
+	void buildNodeBounds();		// the height range of every quadtree node (a 3D box), bottom-up
+	void calculateCellPlanes(int x0, int z0, int x1, int z1);	// the planes of cells [x0, x1) x [z0, z1)
+	float planeHeight(const Vector3f &pos, float &normalY) const;	// the surface under pos, read from cellPlanes
+	CELLPLANES makeCellPlanes(int x, int z) const;		// the planes of cell [x][z] from its 4 points
+	void calculateGradients(int x0, int z0, int x1, int z1);	// the gradients of points [x0, x1) x [z0, z1)
+	TERRAINGRADIENT pointGradient(int x, int z) const;		// read from terrainGradients, or computed when streaming
 
+	// ray casting: the quadtree nodes are boxes (boundary and height range), a leaf is walked cell by cell
+	bool traceRay(Vector3f origin, Vector3f direction, float maxDistance, bool anyHit, RAYHIT &hit) const;
+	bool rayBox(const TERRAINQUADTREENODE &node, Vector3f origin, Vector3f direction, float maxDistance,
+							float &tEnter, float &tExit) const;
+	bool rayLeaf(const TERRAINQUADTREENODE &node, Vector3f origin, Vector3f direction, float tEnter, float tExit, RAYHIT &hit) const;
+	bool rayCell(int x, int z, Vector3f origin, Vector3f direction, float tEnter, float tExit, RAYHIT &hit) const;
+
+	// startup timing report
+	struct STAGETIME
+	{
+		const char *name;
+		double ms;
+	};
+	vector<STAGETIME> stageTimes;
+	chrono::steady_clock::time_point stageStart;
+	void recordStage(const char *name);		// time since the previous stage
+
+	// the terrain height at [x][z], read from the samples when streaming
+	float height(int x, int z) const
+	{
+		if (!streaming)
+			return terrainHeights[x][z];
+
+		// streamed heights repeat the edge past the last row and column
+		x = (x < 0) ? 0 : ((x >= dWidth) ? dWidth-1 : x);
+		z = (z < 0) ? 0 : ((z >= dHeight) ? dHeight-1 : z);
+		return heightField.getSample(x, z) * scaleHeight;
+	}
+
+	// the terrain point at [x][z], x and z are implicit in the indices
+	Vector3f vertex(int x, int z) const
+	{
+		return Vector3f(x*terrainScale - adjFromOrig, height(x, z), z*terrainScale - adjFromOrig);
+	}
+
+	Vector3f vertexNormal(int x, int z) const;	// read from terrainNormals, or computed when streaming
+	void drawVertex(int x, int z);
+	void prefetchVisibleTiles();
 
 public:
 	QTTerrain(){}
 	QTTerrain(char *terrainFilename, const int width, const int length,
-              float scaleH, float scale, int normalsFlag);
+              float scaleH, float scale, int normalsFlag, int normalStorage = NORMALS_FLOAT3,
+              int heightLookup = HEIGHTS_FROM_POINTS);
+	QTTerrain(char *terrainFilename, int normalsFlag, int normalStorage = NORMALS_FLOAT3,
+              int heightLookup = HEIGHTS_FROM_POINTS);	// size and scales read from the heightmap header (throws without one)
+	QTTerrain(const HEIGHTMAPNOISE &noise, int normalsFlag, int normalStorage = NORMALS_FLOAT3,
+              int heightLookup = HEIGHTS_FROM_POINTS);	// a procedural terrain
 	//QTTerrain(char *terrainFilename, char *TerrainTexFilename, char *waterTexFilename);
 	~QTTerrain();
 
@@ -122,25 +227,52 @@ public:
 
   //uint8_t **heightField;					// the size of the heightfield[x][y]
 	//vector<vector<Vector3f> > terrainNormals;	// the terrain normals for each point 32*32=1024
-	vector<vector<Vector3f> > terrainData;		// the terrain data points row and cols
 
 	void LoadTexture(char *textureFile);
+	void uploadTextures();		// loads and uploads the texture, call on the main thread once SDL and the OpenGL context exist
 	void printTerrainData();
-	void render(Vector3f cameraPos);
+	void render(Vector3f cameraPos, const float *viewProjection = NULL);	// viewProjection: 16 column-major floats (Camera::getViewProjection)
 	void update();
 	void generateTerrainPoints();
-	void calculateCellBoundary();
-	float getHeight(Vector3f pos);
-	void posToArrayIndex(Vector3f &pos, int &inX, int &inZ);
-	bool withinBoundary(Vector3f pos, CELLINFO bounds);
-	float distanceToPlane(Vector3f pos);
-	Vector3f calculateFaceNormal(Vector3f p0, Vector3f p1, Vector3f p2);
+	CELLINFO cellBounds(int x, int z) const;		// boundary of cell [x][z], computed from its index
+	Vector3f calculateFaceNormal(Vector3f p0, Vector3f p1, Vector3f p2) const;
 	void calculateNormals(int flag);
 	unsigned char *LoadBitmapFile(char *filename, BITMAPINFOHEADER *bitmapInfoHeader);
 	bool LoadTextures(char *TerrainFilename, char *waterFilename);
 	void setViewRange(float value);
+	void setTileBudget(size_t bytes);		// memory budget of the tile cache (streaming only)
+	void reportTileCache();
+	void reportStartup();		// time spent in each startup stage
+	void compareNormals();	// benchmark NORMAL_CENTRAL against NORMAL_SMOOTH
+
+	// runtime terrain editing (craters, earthworks, erosion): heights are world heights of
+	// the points [x0, x0+width) x [z0, z0+length), stored [x][z] (heights[x * length + z])
+	void setHeights(int x0, int z0, int width, int length, const float *heights);
+	void readHeights(int x0, int z0, int width, int length, float *heights);
+
+	// n rays at once, shared by the thread pool (call from one thread, see TerrainView for one ray)
+	void rayCast(const Vector3f *origins, const Vector3f *directions, size_t n, float maxDistance, RAYHIT *hits);
+
+	// TerrainView: read-only queries, safe to call from several threads (update() starts a
+	// new frame of line of sight answers and must not run alongside them)
+	int getWidth() const { return dWidth; }
+	int getLength() const { return dHeight; }
+	float getCellSpacing() const { return terrainScale; }
+	CELLINFO getBoundary() const { return boundary; }
+	float getHeight(const Vector3f &pos) const;
+	void getHeights(const float *xs, const float *zs, float *out, size_t n) const;
+	float distanceToPlane(const Vector3f &pos) const;
+	Vector3f getNormal(const Vector3f &pos) const;
+	TERRAINGRADIENT getGradient(const Vector3f &pos) const;
+	float getSlope(const Vector3f &pos) const;
+	void getGradients(const float *xs, const float *zs, TERRAINGRADIENT *out, size_t n) const;
+	void posToArrayIndex(const Vector3f &pos, int &inX, int &inZ) const;
+	bool rayCast(const Vector3f &origin, const Vector3f &direction, float maxDistance, RAYHIT &hit) const;
+	bool lineOfSight(const Vector3f &from, const Vector3f &to) const;
+	void lineOfSight(const Vector3f *from, const Vector3f *to, size_t n, bool *visible) const;
   void setWireframe();
   void setEdgeMode();
+  void setFrustumCulling();
 };
 
 #endif
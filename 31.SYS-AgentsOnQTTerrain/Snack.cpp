@@ -74,7 +74,7 @@ void Snack::autonomy()
 		vPos.z = newZ;
 	}
 
-	placeAgentOnTerrain();
+	// the height is set for all agents of a species at once (Agent::placeAgentsOnTerrain)
 }
 void Snack::isEaten()
 {
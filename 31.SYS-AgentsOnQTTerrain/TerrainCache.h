@@ -0,0 +1,83 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ Terrain Cache Class
+//
+//  A precomputed terrain (.qtc file) saved next to its heightmap
+//  so that later runs skip generating the terrain points, normals
+//  and quadtree. The file is memory mapped in one go and is only
+//  used when the checksum of the heightmap and the terrain
+//  settings match the ones it was built with
+//
+//  .qtc file layout
+//    TERRAINCACHEHEADER
+//    float[width * length]								heights, row by row ([x][z])
+//    normals[width * length]							as stored by the terrain (NormalBuffer.h)
+//    TERRAINQUADTREENODE[nodeCount]			the flattened qtNodeArray
+//    TERRAINQUADTREENODEDATA[nodeCount]	the flattened qtNodeData
+//
+//	##########################################################
+
+#ifndef TERRAINCACHE_H
+#define TERRAINCACHE_H
+
+#include <stdint.h>
+#include "MappedFile.h"
+#include "TerrainQuadTree.h"
+#include "NormalBuffer.h"
+
+#define TERRAINCACHE_MAGIC		0x43545451		// 'QTTC'
+#define TERRAINCACHE_VERSION	8
+
+struct TERRAINCACHEHEADER
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceChecksum;		// checksum of the heightmap file
+	int32_t width, length;			// number of samples along x and z
+	float cellSpacing;					// distance between samples in OpenGL units
+	float heightScale;					// world height of a sample of 1.0
+	int32_t normalsFlag;				// NORMAL_FLAT, NORMAL_SMOOTH or NORMAL_CENTRAL
+	int32_t qtLevel;						// quadtree levels
+	uint32_t nodeCount;					// number of quadtree nodes
+	uint32_t nodeBytes;					// sizeof(TERRAINQUADTREENODE) when written
+	uint32_t nodeDataBytes;			// sizeof(TERRAINQUADTREENODEDATA) when written
+	int32_t normalStorage;			// NORMALS_FLOAT3, NORMALS_OCT16 or NORMALS_OCT8, the normals are kept in it
+	uint64_t heightsOffset;			// file offsets of the sections
+	uint64_t normalsOffset;
+	uint64_t nodesOffset;
+	uint64_t nodeDataOffset;
+};
+
+class TerrainCache
+{
+private:
+	MappedFile file;
+	const TERRAINCACHEHEADER *header;	// points into the mapping, or NULL
+
+	// a cache owns a mapping, copying is not allowed
+	TerrainCache(const TerrainCache &);
+	TerrainCache &operator=(const TerrainCache &);
+
+public:
+	TerrainCache();
+
+	static uint64_t checksumFile(const char *filename);		// 64-bit FNV-1a of the file, 0 if unreadable
+	static bool write(const char *filename, const TERRAINCACHEHEADER &info, const float *heights,
+										const unsigned char *normals, const TERRAINQUADTREENODE *nodes, const TERRAINQUADTREENODEDATA *nodeData);
+
+	bool open(const char *filename);		// map and check the layout
+	void close();
+
+	// true when the cache was built from the same heightmap and settings
+	bool matches(const TERRAINCACHEHEADER &expected) const;
+
+	const TERRAINCACHEHEADER &getHeader() const { return *header; }
+	const float *getHeights() const { return (const float*)(file.getData() + header->heightsOffset); }
+	const unsigned char *getNormals() const { return file.getData() + header->normalsOffset; }	// NormalBuffer::storedBytes each
+	const TERRAINQUADTREENODE *getNodes() const { return (const TERRAINQUADTREENODE*)(file.getData() + header->nodesOffset); }
+	const TERRAINQUADTREENODEDATA *getNodeData() const { return (const TERRAINQUADTREENODEDATA*)(file.getData() + header->nodeDataOffset); }
+};
+
+#endif
@@ -0,0 +1,27 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ utility header
+//
+//  Seeded value noise and fractal Brownian motion (fBm) for
+//  procedural heightmaps. The lattice values come from a hash of
+//  the seed and the lattice point, so any sample can be computed
+//  on its own: the result does not depend on the order or on the
+//  thread that computes it
+//
+//	##########################################################
+
+#ifndef TERRAINNOISE_H
+#define TERRAINNOISE_H
+
+#include <stdint.h>
+
+// value noise in 0..1 at (x, z) in lattice units, smooth between lattice points
+float valueNoise(uint32_t seed, float x, float z);
+
+// octaves of value noise, each at twice the frequency of the previous one and
+// persistence times its amplitude, normalised to 0..1
+float fbmNoise(uint32_t seed, float x, float z, int octaves, float persistence);
+
+#endif
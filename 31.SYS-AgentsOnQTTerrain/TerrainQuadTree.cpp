@@ -10,6 +10,8 @@
 //	##########################################################
 
 #include <iostream>
+#include <string.h>
+#include <stdexcept>
 #include "TerrainQuadTree.h"
 
 using namespace std;
@@ -17,6 +19,12 @@ using namespace std;
 TerrainQuadTree::TerrainQuadTree()
 {
 	cout<<"---------------------------------->> Creating QuadTree"<<endl;
+	nodeSize = 0;
+	qtNodeArray = NULL;
+	qtNodeData = NULL;
+	culledNodes = 0;
+	originX = originZ = 0.0f;		// one unit per cell until setPointGrid
+	cellSpacing = 1.0f;
 }
 // unsigned int _vertexX, unsigned int _vertexY
 TerrainQuadTree::TerrainQuadTree(float _top, float _bottom, float _left, float _right,
@@ -24,275 +32,203 @@ TerrainQuadTree::TerrainQuadTree(float _top, float _bottom, float _left, float _
 {
 	cout<<"---------------------------------->> Creating QuadTree"<<endl;
 
-	// calculate levels log4(1024) = 5
-	// log(1024)/log(4) = 5
-	int levels = log(pow(_bottom - _top, 2)) / log(4);
-	cout<<">> Number of levels calculated from the size of the terrain: "<<levels<<endl;
+	// the depth is chosen by the terrain (see levelsForSize)
+	levels = _level;
+	culledNodes = 0;
+	originX = originZ = 0.0f;		// one unit per cell until setPointGrid
+	cellSpacing = 1.0f;
+	cout<<">> Quadtree levels: "<<levels<<endl;
 
 	// calculate the number of nodes for memory allocation
 	nodeSize = calculateNodeSize(_level);
 
-	// calculate minimum node boundary size
-	// this is for determining when a leaf node is found, for stopping further child node creation
-	minSizeOfQuad = calculateMinQuadSize(_bottom - _top, _level);
-
-
-	//leafNodesIndex = nodeSize - (unsigned int)pow(4, _level-1);
-	//cout<<"********************* LEAF NODES STARTING FROM INDEX:"<<leafNodesIndex<<endl<<endl;
-
 	// allocate memory for it
 	qtNodeArray = (TERRAINQUADTREENODE*)malloc( sizeof(TERRAINQUADTREENODE) * nodeSize );
-	
-	// ----------------------------------------------------------------------->> input first node (root) details
-	cout<<">> Creating First Quadtree Node..."<<endl;
-	TERRAINQUADTREENODE firstNode;	// declare the first node
-
-	// input boundaries
-	firstNode.top = _top;
-	firstNode.bottom = _bottom;
-	firstNode.left = _left;
-	firstNode.right = _right;
-
-	// set IDs
-	firstNode.ID = 0;
-	firstNode.parentID = 0;
-
-	// input layer information
-	firstNode.layerID = 1;	// first layer (this is used as 4^layerID to divide the landscape)
-	firstNode.vInitX = 0;		// where to start the verticeIndex X
-	firstNode.vInitZ = 0;		// where to start the verticeIndex Z
+	qtNodeData = (TERRAINQUADTREENODEDATA*)malloc( sizeof(TERRAINQUADTREENODEDATA) * nodeSize );
+	if ((qtNodeArray == NULL) || (qtNodeData == NULL))
+	{
+		cout<<">> Quadtree: could not allocate "<<nodeSize<<" nodes"<<endl;
+		nodeSize = 0;
+		return;
+	}
 
 	// how many vertices on x and z
 	vertX = _vertX;	// 512
 	vertZ = _vertZ;	// 512
 
-	createQuadTree(firstNode);	// ****** create the quadtree structure (recursion)
+	cout<<">> Creating Quadtree Nodes..."<<endl;
+	createQuadTree(_top, _bottom, _left, _right);	// ****** create the quadtree structure (layer by layer)
 	adjustVerticeIndex();
 
 	// report the quadtree branch index
 	//reportNodeBranchIndex();
 }
 
+// restore the node array saved by a previous run (see TerrainCache.h), no recursion needed
+TerrainQuadTree::TerrainQuadTree(const TERRAINQUADTREENODE *nodes, const TERRAINQUADTREENODEDATA *nodeData,
+																 unsigned int _nodeSize, unsigned int _vertX, unsigned int _vertZ)
+{
+	cout<<"---------------------------------->> Restoring QuadTree: "<<_nodeSize<<" nodes"<<endl;
+
+	nodeSize = _nodeSize;
+	vertX = _vertX;
+	vertZ = _vertZ;
+	culledNodes = 0;
+	originX = originZ = 0.0f;		// one unit per cell until setPointGrid
+	cellSpacing = 1.0f;
+
+	// the last node created is always a leaf
+	levels = nodeData[nodeSize-1].layerID;
+
+	qtNodeArray = (TERRAINQUADTREENODE*)malloc( sizeof(TERRAINQUADTREENODE) * nodeSize );
+	memcpy(qtNodeArray, nodes, sizeof(TERRAINQUADTREENODE) * nodeSize);
+	qtNodeData = (TERRAINQUADTREENODEDATA*)malloc( sizeof(TERRAINQUADTREENODEDATA) * nodeSize );
+
+	// nothing is selected yet (resetNodeVisibility clears the visibleNodes only)
+	// the node data holds Vector3f, which is copied by assignment
+	for(unsigned int i=0; i<nodeSize; i++)
+	{
+		qtNodeArray[i].visible = false;
+		qtNodeData[i] = nodeData[i];
+	}
+}
+
 TerrainQuadTree::~TerrainQuadTree()
 {
 	// for (int i=0; i<nodeSize; ++i)
   //   free(qtNodeArray[i]);
 	cout<<"free(qtNodeArray)"<<endl;
 	free(qtNodeArray);
+	free(qtNodeData);
 	cout<<"free(qtNodeArray) SUCCESS"<<endl;
 }
 
+// each level halves the cells of a leaf, a leaf is at least 2 cells wide (3x3 points)
+// and the tree is at most QT_MAX_LEVELS deep
+unsigned int TerrainQuadTree::levelsForSize(unsigned int vertices, unsigned int leafCells)
+{
+	if (leafCells < 2)
+		leafCells = 2;
+
+	unsigned int level = 1;
+	while ((level < QT_MAX_LEVELS) && ((vertices >> (level - 1)) > leafCells))
+		level++;
+
+	return level;
+}
+
+// a complete tree of _level levels has (4^_level - 1) / 3 nodes
 unsigned int TerrainQuadTree::calculateNodeSize(unsigned int _level)
 {
 	cout<<">> Calculating number of nodes... "<<endl;
-	unsigned int numNodes = 0;
+	if ((_level < 1) || (_level > QT_MAX_LEVELS))
+	{
+		cout<<">> ERROR: a quadtree of "<<_level<<" levels, the limit is "<<QT_MAX_LEVELS<<endl;
+		throw std::length_error("TerrainQuadTree: too many levels");
+	}
+
+	unsigned long long numNodes = 0;
+	unsigned long long levelNodes = 1;
 
-	for(int i=0; i<_level; i++)
+	for(unsigned int i=0; i<_level; i++)
 	{
-		numNodes += pow(4, i);
+		numNodes += levelNodes;
+		levelNodes *= 4;
 		cout<<"Level ["<<i<<"] total nodes now is: "<<numNodes<<endl;
 
 	}
 
 	cout<<"********************* TOTAL NUMBER OF NODES: "<<numNodes<<endl;
-	cout<<"********************* SIZE OF EACH NODE: "<<sizeof(TERRAINQUADTREENODE)<<" BYTES"<<endl;
-	cout<<"********************* TOTAL SIZE OF ALL NODES: "<<sizeof(TERRAINQUADTREENODE)*numNodes<<" BYTES"<<endl;
+	cout<<"********************* SIZE OF EACH NODE: "<<sizeof(TERRAINQUADTREENODE)<<" BYTES (traversal) + "
+			<<sizeof(TERRAINQUADTREENODEDATA)<<" BYTES (drawing)"<<endl;
+	cout<<"********************* TOTAL SIZE OF ALL NODES: "<<sizeof(TERRAINQUADTREENODE)*numNodes<<" BYTES (traversal) + "
+			<<sizeof(TERRAINQUADTREENODEDATA)*numNodes<<" BYTES (drawing)"<<endl;
 
-	return numNodes;
+	return (unsigned int)numNodes;
 }
 
-float TerrainQuadTree::calculateMinQuadSize(float _width, unsigned int _level)
+// the nodes are created layer by layer (breadth-first): a node's branches are
+// made from the node's own boundary and points, so the parents are always ready
+void TerrainQuadTree::createQuadTree(float _top, float _bottom, float _left, float _right)
 {
-	float size = _width;
-
-	for(int i=0; i<_level-1; i++)
+	for(unsigned int i=0; i<nodeSize; i++)
 	{
-		size *= 0.5;
-		//cout<<size<<endl;
-	}
-
-	cout<<"********************* Smallest Quad Size (Leaf Node Size): "<<size<<" OpenGL 3D Units"<<endl;
-
-	return size;
-}
-
-//void CQuadTree::createQuadTree(float _top, float _bottom, float _left, float _right, unsigned int parentID, unsigned int nodeID)
-void TerrainQuadTree::createQuadTree(TERRAINQUADTREENODE &thisNode)
-{
-	static int nodeIndex;
-	unsigned int theCurrentNodeType;
+		TERRAINQUADTREENODE *pNode = &qtNodeArray[i];
+		TERRAINQUADTREENODEDATA *pData = &qtNodeData[i];
+		int vEndX, vEndZ;		// the node spans the points vInit..vEnd
 
-	// set the default visibility of the node
-
-	// testing for leaf and assigning nodeType based on the size of the quad
-	if ((thisNode.bottom - thisNode.top) == minSizeOfQuad)
-	{	theCurrentNodeType = QT_LEAF;	}
-	else
-	{	theCurrentNodeType = QT_NODE;	}
-
-		// ------------------------------------------------------------------------------------------------------->> CREATE THIS NODE
-		//cout<<"------------------------------------------------------------------------------  node["<<thisNode.ID<<"] parent["<<thisNode.parentID<<"]"<<endl;
-
-		// declare a pointer to the qtNodeArray's [nodeID]'s element
-		TERRAINQUADTREENODE *pNode = &qtNodeArray[thisNode.ID];
+		if (i == 0)
+		{
+			// ----------------------------------------------------------------------->> the root covers the terrain
+			pData->layerID = 1;	// first layer
+			pNode->top = 			_top;
+			pNode->bottom = 	_bottom;
+			pNode->left = 		_left;
+			pNode->right = 		_right;
+			pData->vInitX = 0;		// where to start the verticeIndex X
+			pData->vInitZ = 0;		// where to start the verticeIndex Z
+			vEndX = vertX;
+			vEndZ = vertZ;
+		}
+		else
+		{
+			// ----------------------------------------------------------------------->> a quadrant of the parent
+			const TERRAINQUADTREENODE &parent = qtNodeArray[parentIndex(i)];
+			const TERRAINQUADTREENODEDATA &parentData = qtNodeData[parentIndex(i)];
+			unsigned int quadrant = (i - 1) % 4;		// 0 NW, 1 SW, 2 NE, 3 SE
+			bool south = (quadrant & 1) != 0;
+			bool east = (quadrant & 2) != 0;
+
+			// half of the parent's boundary
+			float halfZ = (parent.bottom - parent.top) / 2;
+			float halfX = (parent.right - parent.left) / 2;
+			pData->layerID = 	parentData.layerID + 1;		// the next layer now
+			pNode->top = 			south ? parent.bottom - halfZ : parent.top;
+			pNode->bottom = 	pNode->top + halfZ;
+			pNode->left = 		east ? parent.right - halfX : parent.left;
+			pNode->right = 		pNode->left + halfX;
+
+			// half of the parent's points, split at the parent's middle points
+			pData->vInitX = 	parentData.verticeIndex[east ? 1 : 0][0].x;
+			pData->vInitZ = 	parentData.verticeIndex[0][south ? 1 : 0].z;
+			vEndX = 					parentData.verticeIndex[east ? 2 : 1][0].x;
+			vEndZ = 					parentData.verticeIndex[0][south ? 2 : 1].z;
+		}
 
-		pNode->parentID = 	thisNode.parentID;	// parent id comes from the previous node's ID
-		pNode->ID = 				thisNode.ID;				// this node ID is the nodeIndex passed in
-		pNode->nodeType = 	theCurrentNodeType;	// assign node type
+		pData->ID = 				i;
+		pNode->nodeType = 	(pData->layerID == levels) ? QT_LEAF : QT_NODE;	// the leaves are on layer levels
 		pNode->visible =		false;							// default visibility (set later at setRenderable());
 
-		// calculate the width and height of this node from the bounds passed in
+		// calculate the width and height of this node from its bounds
 		// note that all quadrants (child nodes) in the level has the same width and height
-		pNode->width = 			thisNode.bottom - thisNode.top;
-		pNode->height = 		thisNode.right - thisNode.left;
-
-		// receives boundary parameters for this node
-		pNode->top = 			thisNode.top;
-		pNode->bottom = 	thisNode.bottom;
-		pNode->left = 		thisNode.left;
-		pNode->right = 		thisNode.right;
+		pData->width = 			pNode->bottom - pNode->top;
+		pData->height = 		pNode->right - pNode->left;
 
 		// calculate central axial position of this node (centre of quad boundary)
-		pNode->position.x =	((thisNode.left + thisNode.right) / 2);
-		pNode->position.z =	((thisNode.top + thisNode.bottom) / 2);
+		pData->position.x =	((pNode->left + pNode->right) / 2);
+		pData->position.z =	((pNode->top + pNode->bottom) / 2);
+		pData->position.y = 0;
 
-		//cout<<"nodeType:: "<<pNode->nodeType<<"   | width:"<<pNode->width<<" height:"<<pNode->height<<" | top:"<<thisNode.top<<" bottom:"<<thisNode.bottom<<" left:"<<thisNode.left<<" right:"<<thisNode.right<<endl;
-		//cout<<"central position: "<<pNode->position.x<<" "<<pNode->position.y<<" "<<pNode->position.z<<endl;
+		// the height range is filled in once the heights are known (bottom-up, see mergeBranchBounds)
+		pNode->minHeight = 0;
+		pNode->maxHeight = 0;
 
-		// start-------------------------------------------------------------------------------------------------> PUT NODE VERTICE INDEX HERE!!!
-		// calculate divs on each layer, for root layer, layerID=1
-		// (pNode->width*pow(2, thisNode.layerID)/2) is to maintain the original max terrain size
-		//int divs = (pNode->width*pow(2, thisNode.layerID)/2) / pow(2, thisNode.layerID);
-		int divs = (vertX/pow(2, thisNode.layerID));		// -1 because the terrainData array is 0-31 elements (total 32).
-		// cout<<"----- verticeIndex] layerID:"<<thisNode.layerID<<endl;
-		// cout<<(pNode->width*pow(2, thisNode.layerID)/2)<<" / 2^"<<thisNode.layerID<<" = "<<divs<<" |   2^"<<thisNode.layerID<<": "<<pow(2, thisNode.layerID)<<endl;
-		// 512 / 2^1 = 256 |    2^1: 2
+		// the middle points split the node's points in halves (any terrain size, not only powers of 2)
+		int midX = (pData->vInitX + vEndX) / 2;
+		int midZ = (pData->vInitZ + vEndZ) / 2;
+		int pointsX[3] = { pData->vInitX, midX, vEndX };
+		int pointsZ[3] = { pData->vInitZ, midZ, vEndZ };
 
 		// construct and store vertex indices
-		//cout<<"-------------------- Construct VerticeIndex"<<endl;
 		for(int x=0; x<3; x++)
 		{
 			for(int z=0; z<3; z++)
 			{
-				pNode->verticeIndex[x][z].x = thisNode.vInitX + (divs * x);
-				pNode->verticeIndex[x][z].z = thisNode.vInitZ + (divs * z);
-				// cout<<"pNode->verticeIndex[x][z].x<< = <<thisNode.vInitX<< + (<<divs<< * <<x<<);"<<endl;
-				// cout<<pNode->verticeIndex[x][z].x<<" = "<<thisNode.vInitX<<" + ("<<divs<<" * "<<x<<");"<<endl;
-				// cout<<pNode->verticeIndex[x][z].z<<" = "<<thisNode.vInitZ<<" + ("<<divs<<" * "<<z<<");"<<endl;
-
-				//cout<<"verticeIndex["<<pNode->verticeIndex[x][z].x<<" "<<pNode->verticeIndex[x][z].z<<"]  "<<endl;
+				pData->verticeIndex[x][z].x = pointsX[x];
+				pData->verticeIndex[x][z].z = pointsZ[z];
 			}
-			// cout<<endl;
-		}
-
-		// end-------------------------------------------------------------------------------------------------> PUT NODE VERTICE INDEX HERE!!!
-
-
-		// ------------------------------------------------------------------------------------------------------->> CREATE CHILD NODES
-		if(theCurrentNodeType == QT_LEAF)	// if leaf, quit
-		{
-			//cout<<"A LEAF NODE -- STOP CREATING FURTHER CHILD"<<endl;
-			return;
-		}
-		else														// otherwise, create its children nodes
-		{
-			//cout<<"A NODE -- CREATE FURTHER CHILD"<<endl;
-
-			// PREPARE A TEMP QUADTREENODE STRUCT
-			// prepare boundary variables
-			TERRAINQUADTREENODE childNode;
-			//float childwidth, childheight, childtop, childbottom, childleft, childright;
-
-			// calculate width and height of every child node (parent size divided by 2, all child are the same)
-			childNode.width = 		pNode->width / 2;
-			childNode.height = 		pNode->height / 2;
-
-			//  ----------------------------------------------------------------------------------------------- QUADRANT 0 (NW)
-			nodeIndex++; 		// go to next index
-			pNode->branchIndex[0] = nodeIndex;
-
-			// calculate boundary
-			childNode.top = 			pNode->top;
-			childNode.bottom = 		pNode->top + childNode.height;
-			childNode.left = 			pNode->left;
-			childNode.right = 		pNode->left + childNode.width;
-			childNode.parentID = 	thisNode.ID;			// parent nodeIndex
-			childNode.ID = 				nodeIndex;
-
-			childNode.layerID = 	thisNode.layerID + 1;		// the next layer now
-			childNode.vInitX = 		thisNode.vInitX;			// based on parent's
-			childNode.vInitZ = 		thisNode.vInitZ;			// based on parent's
-
-			//cout<<"pNode->branchIndex[0]: "<<nodeIndex;
-			//cout<<" | top:"<<childtop<<" bottom:"<<childbottom<<" left:"<<childleft<<" right:"<<childright<<endl;
-
-			createQuadTree(childNode);
-
-			// ----------------------------------------------------------------------------------------------- QUADRANT 1 (SW)
-			nodeIndex++; 		// go to next index
-			pNode->branchIndex[1] = nodeIndex;
-
-			// calculate boundary
-			childNode.top = 			pNode->bottom - childNode.height;
-			childNode.bottom = 		childNode.top + childNode.height;
-			childNode.left = 			pNode->left;
-			childNode.right = 		pNode->left + childNode.width;
-			childNode.parentID = 	thisNode.ID;			// parent nodeIndex
-			childNode.ID = 				nodeIndex;
-
-			childNode.layerID = 	thisNode.layerID + 1;		// the next layer now
-			childNode.vInitX = 		thisNode.vInitX;		// based on parent's
-			childNode.vInitZ = 		thisNode.vInitZ + divs;	// based on parent's + divs
-
-			createQuadTree(childNode);
-
-			// ----------------------------------------------------------------------------------------------- QUADRANT 2 (NE)
-			nodeIndex++; 				// go to next index
-			pNode->branchIndex[2] = nodeIndex;
-			//cout<<"pNode->branchIndex[2]: "<<nodeIndex<<endl;
-
-			// calculate boundary
-			childNode.top = 			pNode->top;
-			childNode.bottom = 	pNode->top + childNode.height;
-			childNode.left = 			pNode->right - childNode.width;
-			childNode.right = 		childNode.left + childNode.width;
-			childNode.parentID = 	thisNode.ID;			// parent nodeIndex
-			childNode.ID = 			nodeIndex;
-
-			childNode.layerID = 		thisNode.layerID + 1;		// the next layer now
-			childNode.vInitX = 		thisNode.vInitX + divs;	// based on parent's + divs
-			childNode.vInitZ =		thisNode.vInitZ;			// based on parent's
-
-			createQuadTree(childNode);
-
-			// ----------------------------------------------------------------------------------------------- QUADRANT 3 (SE)
-			nodeIndex++; 				// go to next index
-			pNode->branchIndex[3] = nodeIndex;
-			//cout<<"pNode->branchIndex[3]: "<<nodeIndex<<endl;
-
-			// calculate boundary
-			childNode.top = 		pNode->bottom - childNode.height;
-			childNode.bottom = 	childNode.top + childNode.height;
-			childNode.left = 		pNode->right - childNode.width;
-			childNode.right = 		childNode.left + childNode.width;
-			childNode.parentID = 	thisNode.ID;			// parent nodeIndex
-			childNode.ID = 		nodeIndex;
-
-			childNode.layerID = 		thisNode.layerID + 1;		// the next layer now
-			childNode.vInitX = 		thisNode.vInitX + divs;	// based on parent's + divs
-			childNode.vInitZ =		thisNode.vInitZ + divs;	// based on parent's + divs
-
-			createQuadTree(childNode);
-
-			//cout<<endl;
 		}
-
-
-		// Go to next level's nodeIndex
-		//nodeIndex++;
-
-	//}
-
+	}
 }
 
 void TerrainQuadTree::adjustVerticeIndex()
@@ -305,46 +241,61 @@ void TerrainQuadTree::adjustVerticeIndex()
 		{
 			for(int z=0; z<3; z++)
 			{
-				// cout<<"["<<qtNodeArray[i].verticeIndex[x][z].x<<" "<<qtNodeArray[i].verticeIndex[x][z].z<<"]  "<<endl;;
+				// cout<<"["<<qtNodeData[i].verticeIndex[x][z].x<<" "<<qtNodeData[i].verticeIndex[x][z].z<<"]  "<<endl;;
 
-				if (qtNodeArray[i].verticeIndex[x][z].x > 0)
-					qtNodeArray[i].verticeIndex[x][z].x = qtNodeArray[i].verticeIndex[x][z].x - 1;
+				if (qtNodeData[i].verticeIndex[x][z].x > 0)
+					qtNodeData[i].verticeIndex[x][z].x = qtNodeData[i].verticeIndex[x][z].x - 1;
 
-				// cout<<"BEFORE:: qtNodeArray[i].verticeIndex[x][z].z "<<qtNodeArray[i].verticeIndex[x][z].z<<endl;
-				if (qtNodeArray[i].verticeIndex[x][z].z > 0)
+				// cout<<"BEFORE:: qtNodeData[i].verticeIndex[x][z].z "<<qtNodeData[i].verticeIndex[x][z].z<<endl;
+				if (qtNodeData[i].verticeIndex[x][z].z > 0)
 				{
-					qtNodeArray[i].verticeIndex[x][z].z = qtNodeArray[i].verticeIndex[x][z].z - 1;
-					// cout<<"AFTER:: qtNodeArray[i].verticeIndex[x][z].z "<<qtNodeArray[i].verticeIndex[x][z].z<<endl;
+					qtNodeData[i].verticeIndex[x][z].z = qtNodeData[i].verticeIndex[x][z].z - 1;
+					// cout<<"AFTER:: qtNodeData[i].verticeIndex[x][z].z "<<qtNodeData[i].verticeIndex[x][z].z<<endl;
 				}
 
 
 			}
 		}
+
+		// the corners of the points for walking the tree
+		qtNodeArray[i].firstVertex = qtNodeData[i].verticeIndex[0][0];
+		qtNodeArray[i].lastVertex = qtNodeData[i].verticeIndex[2][2];
 	}
 }
 
+// only the nodes selected last frame can be visible, the rest of the tree is not touched
 void TerrainQuadTree::resetNodeVisibility()
 {
-	for(int i=0; i<nodeSize; i++)
+	for(size_t i=0; i<visibleNodes.size(); i++)
 	{
 		// clear visible state to default
-		qtNodeArray[i].visible = false;
+		qtNodeArray[visibleNodes[i]].visible = false;
 
 	}
+	visibleNodes.clear();
+	culledNodes = 0;
 }
 
-void TerrainQuadTree::testRenderable(TERRAINQUADTREENODE &parentNode, Vector3f pos, float range)
+void TerrainQuadTree::selectNode(unsigned int nodeID)
 {
+	qtNodeArray[nodeID].visible = true;
+	visibleNodes.push_back(nodeID);
+}
+
+// with a frustum, a branch whose box is outside it is neither drawn nor refined
+void TerrainQuadTree::testRenderable(unsigned int nodeID, Vector3f pos, float range, const FRUSTUM *frustum)
+{
+	TERRAINQUADTREENODE &parentNode = qtNodeArray[nodeID];
 
 	// -------------------------------------------------------------------------------- DEBUG
 	/*
 		unsigned int node = 64;
-		float sx = qtNodeArray[node].position.x - pos.x;
-		float sy = qtNodeArray[node].position.y - pos.y;
-		float sz = qtNodeArray[node].position.z - pos.z;
+		float sx = qtNodeData[node].position.x - pos.x;
+		float sy = qtNodeData[node].position.y - pos.y;
+		float sz = qtNodeData[node].position.z - pos.z;
 		float sd = sqrt(	(sx*sx) + (sz*sz) );
 
-		cout<<"node "<<node<<": "<<qtNodeArray[node].position.x<<" "<<qtNodeArray[node].position.y<<" "<<qtNodeArray[node].position.z<<" | ";
+		cout<<"node "<<node<<": "<<qtNodeData[node].position.x<<" "<<qtNodeData[node].position.y<<" "<<qtNodeData[node].position.z<<" | ";
 
 		if(sd < range)	// if the distance is close enough, set drawable
 		{
@@ -355,7 +306,7 @@ void TerrainQuadTree::testRenderable(TERRAINQUADTREENODE &parentNode, Vector3f p
 			cout<<sd<<" out of range ("<<range<<")"<<endl;
 		}
 		cout<<"cam: "<<pos.x<<" "<<pos.y<<" "<<pos.z<<endl;
-		cout<<qtNodeArray[node].position.x - pos.x<<" "<<qtNodeArray[node].position.y - pos.y<<" "<<qtNodeArray[node].position.z - pos.z<<endl;
+		cout<<qtNodeData[node].position.x - pos.x<<" "<<qtNodeData[node].position.y - pos.y<<" "<<qtNodeData[node].position.z - pos.z<<endl;
 	*/
 	// -------------------------------------------------------------------------------- DEBUG
 
@@ -370,162 +321,178 @@ void TerrainQuadTree::testRenderable(TERRAINQUADTREENODE &parentNode, Vector3f p
 		// ----------------->> calculate this node's four quadrants
 
 		// @@@@@@@@@@@ FIRST child node
-		//float x = qtNodeArray[parentNode.branchIndex[0]].position.x - pos.x;
-		//float y = qtNodeArray[parentNode.branchIndex[0]].position.y - pos.y;
-		//float z = qtNodeArray[parentNode.branchIndex[0]].position.z - pos.z;
+		//float x = qtNodeData[branchIndex(nodeID, 0)].position.x - pos.x;
+		//float y = qtNodeData[branchIndex(nodeID, 0)].position.y - pos.y;
+		//float z = qtNodeData[branchIndex(nodeID, 0)].position.z - pos.z;
 		//float d = sqrt(	(x*x) + (z*z) );
 
-		float TLx = qtNodeArray[parentNode.branchIndex[0]].left - pos.x;
-		float TLz = qtNodeArray[parentNode.branchIndex[0]].top - pos.z;
+		float TLx = qtNodeArray[branchIndex(nodeID, 0)].left - pos.x;
+		float TLz = qtNodeArray[branchIndex(nodeID, 0)].top - pos.z;
 		float TLd = sqrt(	(TLx*TLx) + (TLz*TLz) );
 
-		float TRx = qtNodeArray[parentNode.branchIndex[0]].right - pos.x;
-		float TRz = qtNodeArray[parentNode.branchIndex[0]].top - pos.z;
+		float TRx = qtNodeArray[branchIndex(nodeID, 0)].right - pos.x;
+		float TRz = qtNodeArray[branchIndex(nodeID, 0)].top - pos.z;
 		float TRd = sqrt(	(TRx*TRx) + (TRz*TRz) );
 
-		float BLx = qtNodeArray[parentNode.branchIndex[0]].left - pos.x;
-		float BLz = qtNodeArray[parentNode.branchIndex[0]].bottom - pos.z;
+		float BLx = qtNodeArray[branchIndex(nodeID, 0)].left - pos.x;
+		float BLz = qtNodeArray[branchIndex(nodeID, 0)].bottom - pos.z;
 		float BLd = sqrt(	(BLx*BLx) + (BLz*BLz) );
 
-		float BRx = qtNodeArray[parentNode.branchIndex[0]].right - pos.x;
-		float BRz = qtNodeArray[parentNode.branchIndex[0]].bottom - pos.z;
+		float BRx = qtNodeArray[branchIndex(nodeID, 0)].right - pos.x;
+		float BRz = qtNodeArray[branchIndex(nodeID, 0)].bottom - pos.z;
 		float BRd = sqrt(	(BRx*BRx) + (BRz*BRz) );
 
 		//if(d < range)	// if the distance is close enough, set drawable
-		if((TLd < range) || (TRd < range) || (BLd < range) || (BRd < range))	// if the distance to the four corners of this node is close enough, set drawable
+		if ((frustum != NULL) && outsideFrustum(branchIndex(nodeID, 0), *frustum))
+		{
+			culledNodes++;		// not visible, and no branch of it either
+		}
+		else if((TLd < range) || (TRd < range) || (BLd < range) || (BRd < range))	// if the distance to the four corners of this node is close enough, set drawable
 		{
 			childState0 = true;
-			qtNodeArray[parentNode.branchIndex[0]].visible = false;
-			testRenderable(qtNodeArray[parentNode.branchIndex[0]], pos, range); // recurse into the child nodes
+			qtNodeArray[branchIndex(nodeID, 0)].visible = false;
+			testRenderable(branchIndex(nodeID, 0), pos, range, frustum); // recurse into the child nodes
 
-			//qtNodeArray[parentNode.branchIndex[0]].visible = true;	// is visible
+			//qtNodeArray[branchIndex(nodeID, 0)].visible = true;	// is visible
 
 		}
 		else// if (d >= range)
 		{
 			//childState0 = false;
-			qtNodeArray[parentNode.branchIndex[0]].visible = true;
+			selectNode(branchIndex(nodeID, 0));
 
-			//cout<<"------->> node["<<parentNode.branchIndex[0]<<"] is visible"<<endl;
+			//cout<<"------->> node["<<branchIndex(nodeID, 0)<<"] is visible"<<endl;
 		}
 
 		// second child node
-		//x = qtNodeArray[parentNode.branchIndex[1]].position.x - pos.x;
-		//y = qtNodeArray[parentNode.branchIndex[1]].position.y - pos.y;
-		//z = qtNodeArray[parentNode.branchIndex[1]].position.z - pos.z;
+		//x = qtNodeData[branchIndex(nodeID, 1)].position.x - pos.x;
+		//y = qtNodeData[branchIndex(nodeID, 1)].position.y - pos.y;
+		//z = qtNodeData[branchIndex(nodeID, 1)].position.z - pos.z;
 		//d = sqrt(	(x*x) + (z*z) );
 
-		TLx = qtNodeArray[parentNode.branchIndex[1]].left - pos.x;
-		TLz = qtNodeArray[parentNode.branchIndex[1]].top - pos.z;
+		TLx = qtNodeArray[branchIndex(nodeID, 1)].left - pos.x;
+		TLz = qtNodeArray[branchIndex(nodeID, 1)].top - pos.z;
 		TLd = sqrt(	(TLx*TLx) + (TLz*TLz) );
 
-		TRx = qtNodeArray[parentNode.branchIndex[1]].right - pos.x;
-		TRz = qtNodeArray[parentNode.branchIndex[1]].top - pos.z;
+		TRx = qtNodeArray[branchIndex(nodeID, 1)].right - pos.x;
+		TRz = qtNodeArray[branchIndex(nodeID, 1)].top - pos.z;
 		TRd = sqrt(	(TRx*TRx) + (TRz*TRz) );
 
-		BLx = qtNodeArray[parentNode.branchIndex[1]].left - pos.x;
-		BLz = qtNodeArray[parentNode.branchIndex[1]].bottom - pos.z;
+		BLx = qtNodeArray[branchIndex(nodeID, 1)].left - pos.x;
+		BLz = qtNodeArray[branchIndex(nodeID, 1)].bottom - pos.z;
 		BLd = sqrt(	(BLx*BLx) + (BLz*BLz) );
 
-		BRx = qtNodeArray[parentNode.branchIndex[1]].right - pos.x;
-		BRz = qtNodeArray[parentNode.branchIndex[1]].bottom - pos.z;
+		BRx = qtNodeArray[branchIndex(nodeID, 1)].right - pos.x;
+		BRz = qtNodeArray[branchIndex(nodeID, 1)].bottom - pos.z;
 		BRd = sqrt(	(BRx*BRx) + (BRz*BRz) );
 
 		//if(d < range)	// if the distance is close enough, set drawable
-		if((TLd < range) || (TRd < range) || (BLd < range) || (BRd < range))	// if the distance to the four corners of this node is close enough, set drawable
+		if ((frustum != NULL) && outsideFrustum(branchIndex(nodeID, 1), *frustum))
+		{
+			culledNodes++;		// not visible, and no branch of it either
+		}
+		else if((TLd < range) || (TRd < range) || (BLd < range) || (BRd < range))	// if the distance to the four corners of this node is close enough, set drawable
 		{
 			childState1 = true;
-			qtNodeArray[parentNode.branchIndex[1]].visible = false;
-			testRenderable(qtNodeArray[parentNode.branchIndex[1]], pos, range); // recurse into the child nodes
+			qtNodeArray[branchIndex(nodeID, 1)].visible = false;
+			testRenderable(branchIndex(nodeID, 1), pos, range, frustum); // recurse into the child nodes
 
-			//qtNodeArray[parentNode.branchIndex[1]].visible = true;	// is visible
+			//qtNodeArray[branchIndex(nodeID, 1)].visible = true;	// is visible
 
 		}
 		else// if (d >= range)
 		{
 			//childState1 = false;
-			qtNodeArray[parentNode.branchIndex[1]].visible = true;
+			selectNode(branchIndex(nodeID, 1));
 
-			//cout<<"------->> node["<<parentNode.branchIndex[1]<<"] is visible"<<endl;
+			//cout<<"------->> node["<<branchIndex(nodeID, 1)<<"] is visible"<<endl;
 		}
 
 
 		// third child node
-		//x = qtNodeArray[parentNode.branchIndex[2]].position.x - pos.x;
-		//y = qtNodeArray[parentNode.branchIndex[2]].position.y - pos.y;
-		//z = qtNodeArray[parentNode.branchIndex[2]].position.z - pos.z;
+		//x = qtNodeData[branchIndex(nodeID, 2)].position.x - pos.x;
+		//y = qtNodeData[branchIndex(nodeID, 2)].position.y - pos.y;
+		//z = qtNodeData[branchIndex(nodeID, 2)].position.z - pos.z;
 		//d = sqrt(	(x*x) + (z*z) );
 
-		TLx = qtNodeArray[parentNode.branchIndex[2]].left - pos.x;
-		TLz = qtNodeArray[parentNode.branchIndex[2]].top - pos.z;
+		TLx = qtNodeArray[branchIndex(nodeID, 2)].left - pos.x;
+		TLz = qtNodeArray[branchIndex(nodeID, 2)].top - pos.z;
 		TLd = sqrt(	(TLx*TLx) + (TLz*TLz) );
 
-		TRx = qtNodeArray[parentNode.branchIndex[2]].right - pos.x;
-		TRz = qtNodeArray[parentNode.branchIndex[2]].top - pos.z;
+		TRx = qtNodeArray[branchIndex(nodeID, 2)].right - pos.x;
+		TRz = qtNodeArray[branchIndex(nodeID, 2)].top - pos.z;
 		TRd = sqrt(	(TRx*TRx) + (TRz*TRz) );
 
-		BLx = qtNodeArray[parentNode.branchIndex[2]].left - pos.x;
-		BLz = qtNodeArray[parentNode.branchIndex[2]].bottom - pos.z;
+		BLx = qtNodeArray[branchIndex(nodeID, 2)].left - pos.x;
+		BLz = qtNodeArray[branchIndex(nodeID, 2)].bottom - pos.z;
 		BLd = sqrt(	(BLx*BLx) + (BLz*BLz) );
 
-		BRx = qtNodeArray[parentNode.branchIndex[2]].right - pos.x;
-		BRz = qtNodeArray[parentNode.branchIndex[2]].bottom - pos.z;
+		BRx = qtNodeArray[branchIndex(nodeID, 2)].right - pos.x;
+		BRz = qtNodeArray[branchIndex(nodeID, 2)].bottom - pos.z;
 		BRd = sqrt(	(BRx*BRx) + (BRz*BRz) );
 
 		//if(d < range)	// if the distance is close enough, set drawable
-		if((TLd < range) || (TRd < range) || (BLd < range) || (BRd < range))	// if the distance to the four corners of this node is close enough, set drawable
+		if ((frustum != NULL) && outsideFrustum(branchIndex(nodeID, 2), *frustum))
+		{
+			culledNodes++;		// not visible, and no branch of it either
+		}
+		else if((TLd < range) || (TRd < range) || (BLd < range) || (BRd < range))	// if the distance to the four corners of this node is close enough, set drawable
 		{
 			childState2 = true;
-			qtNodeArray[parentNode.branchIndex[2]].visible = false;
-			testRenderable(qtNodeArray[parentNode.branchIndex[2]], pos, range);	// recurse into the child nodes
+			qtNodeArray[branchIndex(nodeID, 2)].visible = false;
+			testRenderable(branchIndex(nodeID, 2), pos, range, frustum);	// recurse into the child nodes
 
-			//qtNodeArray[parentNode.branchIndex[2]].visible = true;	// is visible
+			//qtNodeArray[branchIndex(nodeID, 2)].visible = true;	// is visible
 
 		}
 		else// if (d >= range)
 		{
 			//childState2 = false;
-			qtNodeArray[parentNode.branchIndex[2]].visible = true;
+			selectNode(branchIndex(nodeID, 2));
 		}
 
 
 		// fourth child node
-		//x = qtNodeArray[parentNode.branchIndex[3]].position.x - pos.x;
-		//y = qtNodeArray[parentNode.branchIndex[3]].position.y - pos.y;
-		//z = qtNodeArray[parentNode.branchIndex[3]].position.z - pos.z;
+		//x = qtNodeData[branchIndex(nodeID, 3)].position.x - pos.x;
+		//y = qtNodeData[branchIndex(nodeID, 3)].position.y - pos.y;
+		//z = qtNodeData[branchIndex(nodeID, 3)].position.z - pos.z;
 		//d = sqrt(	(x*x) + (z*z) );
 
-		TLx = qtNodeArray[parentNode.branchIndex[3]].left - pos.x;
-		TLz = qtNodeArray[parentNode.branchIndex[3]].top - pos.z;
+		TLx = qtNodeArray[branchIndex(nodeID, 3)].left - pos.x;
+		TLz = qtNodeArray[branchIndex(nodeID, 3)].top - pos.z;
 		TLd = sqrt(	(TLx*TLx) + (TLz*TLz) );
 
-		TRx = qtNodeArray[parentNode.branchIndex[3]].right - pos.x;
-		TRz = qtNodeArray[parentNode.branchIndex[3]].top - pos.z;
+		TRx = qtNodeArray[branchIndex(nodeID, 3)].right - pos.x;
+		TRz = qtNodeArray[branchIndex(nodeID, 3)].top - pos.z;
 		TRd = sqrt(	(TRx*TRx) + (TRz*TRz) );
 
-		BLx = qtNodeArray[parentNode.branchIndex[3]].left - pos.x;
-		BLz = qtNodeArray[parentNode.branchIndex[3]].bottom - pos.z;
+		BLx = qtNodeArray[branchIndex(nodeID, 3)].left - pos.x;
+		BLz = qtNodeArray[branchIndex(nodeID, 3)].bottom - pos.z;
 		BLd = sqrt(	(BLx*BLx) + (BLz*BLz) );
 
-		BRx = qtNodeArray[parentNode.branchIndex[3]].right - pos.x;
-		BRz = qtNodeArray[parentNode.branchIndex[3]].bottom - pos.z;
+		BRx = qtNodeArray[branchIndex(nodeID, 3)].right - pos.x;
+		BRz = qtNodeArray[branchIndex(nodeID, 3)].bottom - pos.z;
 		BRd = sqrt(	(BRx*BRx) + (BRz*BRz) );
 
 		//if(d < range)	// if the distance is close enough, set drawable
-		if((TLd < range) || (TRd < range) || (BLd < range) || (BRd < range))	// if the distance to the four corners of this node is close enough, set drawable
+		if ((frustum != NULL) && outsideFrustum(branchIndex(nodeID, 3), *frustum))
+		{
+			culledNodes++;		// not visible, and no branch of it either
+		}
+		else if((TLd < range) || (TRd < range) || (BLd < range) || (BRd < range))	// if the distance to the four corners of this node is close enough, set drawable
 		{
 			childState3 = true;
-			qtNodeArray[parentNode.branchIndex[3]].visible = false;
-			testRenderable(qtNodeArray[parentNode.branchIndex[3]], pos, range);	// recurse into the child nodes
-			//qtNodeArray[parentNode.branchIndex[3]].visible = true;	// is visible
+			qtNodeArray[branchIndex(nodeID, 3)].visible = false;
+			testRenderable(branchIndex(nodeID, 3), pos, range, frustum);	// recurse into the child nodes
+			//qtNodeArray[branchIndex(nodeID, 3)].visible = true;	// is visible
 
 		}
 		else //if (d >= range)
 		{
 			//childState3 = false;
-			qtNodeArray[parentNode.branchIndex[3]].visible = true;
+			selectNode(branchIndex(nodeID, 3));
 
-			//cout<<"------->> node["<<parentNode.branchIndex[3]<<"] is visible"<<endl;
+			//cout<<"------->> node["<<branchIndex(nodeID, 3)<<"] is visible"<<endl;
 		}
 
 		// if any of them is true (visible), the parent visibility should be false
@@ -538,12 +505,47 @@ void TerrainQuadTree::testRenderable(TERRAINQUADTREENODE &parentNode, Vector3f p
 	{
 		// if recursed until leaf, this node must be visible!
 
-		parentNode.visible = true;
-		//cout<<"------->> node["<<parentNode.ID<<"] is visible"<<endl;
+		selectNode(nodeID);
+		//cout<<"------->> node["<<nodeID<<"] is visible"<<endl;
 	}
 
 }
 
+void TerrainQuadTree::setPointGrid(float _originX, float _originZ, float _cellSpacing)
+{
+	originX = _originX;
+	originZ = _originZ;
+	cellSpacing = _cellSpacing;
+}
+
+// the points of the node (not its boundary, which is a cell apart) from the lowest to
+// the highest point of the terrain under it
+bool TerrainQuadTree::outsideFrustum(unsigned int nodeID, const FRUSTUM &frustum)
+{
+	const TERRAINQUADTREENODE &node = qtNodeArray[nodeID];
+
+	// the points are drawn at origin + index * cellSpacing on both axes (the root
+	// boundary is square, it does not follow the points of a non-square terrain)
+	float boxMin[3] = { originX + node.firstVertex.x * cellSpacing, node.minHeight, originZ + node.firstVertex.z * cellSpacing };
+	float boxMax[3] = { originX + node.lastVertex.x * cellSpacing, node.maxHeight, originZ + node.lastVertex.z * cellSpacing };
+	return boxOutsideFrustum(frustum, boxMin, boxMax);
+}
+
+// the branches of a node have higher IDs than the node (4i+1..4i+4), so walking the
+// nodes from the last ID to the first merges every node after its branches
+void TerrainQuadTree::mergeBranchBounds(unsigned int nodeID)
+{
+	TERRAINQUADTREENODE &node = qtNodeArray[nodeID];
+	node.minHeight = qtNodeArray[branchIndex(nodeID, 0)].minHeight;
+	node.maxHeight = qtNodeArray[branchIndex(nodeID, 0)].maxHeight;
+
+	for(int i=1; i<4; i++)
+	{
+		node.minHeight = min(node.minHeight, qtNodeArray[branchIndex(nodeID, i)].minHeight);
+		node.maxHeight = max(node.maxHeight, qtNodeArray[branchIndex(nodeID, i)].maxHeight);
+	}
+}
+
 void TerrainQuadTree::reportNodeBranchIndex()
 {
 	cout<<"----------------------------->> REPORTING NODE BRANCH INDICES"<<endl;
@@ -559,7 +561,7 @@ void TerrainQuadTree::reportNodeBranchIndex()
 
 			for(int j=0; j<4; j++)
 			{
-					cout<<"----------- child branchIndex["<<j<<"]:: "<<qtNodeArray[i].branchIndex[j]<<" visible: "<<qtNodeArray[qtNodeArray[i].branchIndex[j]].visible<<endl;
+					cout<<"----------- child branchIndex["<<j<<"]:: "<<branchIndex(i, j)<<" visible: "<<qtNodeArray[branchIndex(i, j)].visible<<endl;
 			}
 		}
 
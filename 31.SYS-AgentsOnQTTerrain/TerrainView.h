@@ -0,0 +1,86 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ Interface Class
+//
+//  The read-only queries of a terrain: heights, normals, slopes,
+//  rays and line of sight. Every method is const and reentrant,
+//  so one view can be shared by agents updated on several
+//  threads. QTTerrain implements it; its rendering, editing and
+//  loading stay out of reach of the code holding a view
+//
+//	##########################################################
+
+#ifndef TERRAINVIEW_H
+#define TERRAINVIEW_H
+
+#include <stddef.h>
+#include <iostream>
+#include "Vector3f.h"
+
+// which cell is the current cell
+struct CELLINFO
+{
+	float top;
+	float bottom;
+	float left;
+	float right;
+};
+
+// the slope of the terrain at a point: the height change per unit of x and per unit of z
+struct TERRAINGRADIENT
+{
+	float x, z;
+};
+
+// the first point where a ray meets the terrain surface
+struct RAYHIT
+{
+	bool hit;
+	float distance;			// along the ray from its origin
+	Vector3f point;
+	Vector3f normal;			// of the triangle that was hit
+	int cellX, cellZ;		// the cell [x][z] holding the triangle
+};
+
+class TerrainView
+{
+public:
+	virtual ~TerrainView() {}
+
+	// size of the terrain in points, and the distance between them
+	virtual int getWidth() const = 0;
+	virtual int getLength() const = 0;
+	virtual float getCellSpacing() const = 0;
+	virtual CELLINFO getBoundary() const = 0;		// 2D bounding box of the terrain
+
+	// the surface under a position
+	virtual float getHeight(const Vector3f &pos) const = 0;
+	virtual void getHeights(const float *xs, const float *zs, float *out, size_t n) const = 0;	// batched, positions off the terrain are clamped to its edge
+	virtual float distanceToPlane(const Vector3f &pos) const = 0;
+	virtual Vector3f getNormal(const Vector3f &pos) const = 0;		// interpolated surface normal (for agents)
+	virtual TERRAINGRADIENT getGradient(const Vector3f &pos) const = 0;	// interpolated like getNormal, uphill is the direction of the gradient
+	virtual float getSlope(const Vector3f &pos) const = 0;				// the steepest rise per unit of distance at pos
+	virtual void getGradients(const float *xs, const float *zs, TERRAINGRADIENT *out, size_t n) const = 0;	// batched getGradient
+	virtual void posToArrayIndex(const Vector3f &pos, int &inX, int &inZ) const = 0;
+
+	// the first terrain hit of a ray within maxDistance (direction need not be unit length)
+	virtual bool rayCast(const Vector3f &origin, const Vector3f &direction, float maxDistance, RAYHIT &hit) const = 0;
+
+	// line of sight: whether the terrain hides to from from. A batch keeps its answers for the frame
+	// by the cells of the two points, so nearby queries of the frame share them
+	virtual bool lineOfSight(const Vector3f &from, const Vector3f &to) const = 0;
+	virtual void lineOfSight(const Vector3f *from, const Vector3f *to, size_t n, bool *visible) const = 0;
+
+	bool withinBoundary(const Vector3f &pos, const CELLINFO &bounds) const
+	{
+		if ((pos.x > bounds.left) && (pos.x < bounds.right))
+			if ((pos.z > bounds.top) && (pos.z < bounds.bottom))
+				return true;
+
+		return false;
+	}
+};
+
+#endif
@@ -0,0 +1,116 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ Thread Pool Class
+//
+//  Worker threads for row-parallel loops: 'ThreadPool.h'
+//
+//	##########################################################
+
+#include <iostream>
+#include <algorithm>
+#include "ThreadPool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int numThreads)
+{
+	job = NULL;
+	jobBegin = jobEnd = chunkSize = numChunks = 0;
+	nextChunk = 0;
+	generation = 0;
+	activeWorkers = 0;
+	stopping = false;
+
+	if (numThreads <= 0)
+		numThreads = max(1, (int)thread::hardware_concurrency());
+
+	// the calling thread is one of the threads
+	for (int i = 1; i < numThreads; i++)
+		workers.push_back(thread(&ThreadPool::workerLoop, this));
+
+	cout<<">> ThreadPool: "<<numThreads<<" threads"<<endl;
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wakeWorkers.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+// take chunks until there are none left
+void ThreadPool::runChunks()
+{
+	int chunk;
+	while ((chunk = nextChunk++) < numChunks)
+	{
+		int rowBegin = jobBegin + chunk * chunkSize;
+		int rowEnd = min(jobEnd, rowBegin + chunkSize);
+		(*job)(rowBegin, rowEnd);
+	}
+}
+
+void ThreadPool::workerLoop()
+{
+	unsigned int seen = 0;
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> guard(lock);
+			while (!stopping && (generation == seen))
+				wakeWorkers.wait(guard);
+
+			if (stopping) return;
+			seen = generation;
+		}
+
+		runChunks();
+
+		lock_guard<mutex> guard(lock);
+		if (--activeWorkers == 0)
+			jobDone.notify_one();
+	}
+}
+
+void ThreadPool::parallelFor(int begin, int end, const function<void(int, int)> &body, int minChunk)
+{
+	int rows = end - begin;
+	if (rows <= 0) return;
+
+	// a few chunks per thread balances rows of uneven cost
+	int chunks = min(getThreadCount() * 4, max(1, rows / max(1, minChunk)));
+	if ((workers.size() == 0) || (chunks == 1))
+	{
+		body(begin, end);
+		return;
+	}
+
+	{
+		lock_guard<mutex> guard(lock);
+		job = &body;
+		jobBegin = begin;
+		jobEnd = end;
+		chunkSize = (rows + chunks - 1) / chunks;
+		numChunks = (rows + chunkSize - 1) / chunkSize;
+		nextChunk = 0;
+		activeWorkers = (int)workers.size();
+		generation++;
+	}
+	wakeWorkers.notify_all();
+
+	runChunks();
+
+	// wait for the workers to finish their last chunk
+	unique_lock<mutex> guard(lock);
+	while (activeWorkers > 0)
+		jobDone.wait(guard);
+	job = NULL;
+}
@@ -0,0 +1,60 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ Thread Pool Class
+//
+//  A fixed set of worker threads for splitting a loop over rows
+//  (parallelFor). The range is cut into contiguous chunks that
+//  are shared by the workers and the calling thread; each row is
+//  processed exactly once, so a loop that only writes its own
+//  rows gives the same result as the serial loop
+//
+//	##########################################################
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+
+	// the loop being run
+	const std::function<void(int, int)> *job;
+	int jobBegin, jobEnd, chunkSize, numChunks;
+	std::atomic<int> nextChunk;
+
+	std::mutex lock;
+	std::condition_variable wakeWorkers;
+	std::condition_variable jobDone;
+	unsigned int generation;		// incremented for every job
+	int activeWorkers;					// workers still running the current job
+	bool stopping;
+
+	// a pool owns its threads, copying is not allowed
+	ThreadPool(const ThreadPool &);
+	ThreadPool &operator=(const ThreadPool &);
+
+	void workerLoop();
+	void runChunks();
+
+public:
+	ThreadPool(int numThreads = 0);		// 0 uses one thread per hardware core
+	~ThreadPool();
+
+	// call body(rowBegin, rowEnd) over [begin, end) in chunks of at least minChunk rows
+	// and return when every row is done (not reentrant)
+	void parallelFor(int begin, int end, const std::function<void(int, int)> &body, int minChunk = 1);
+
+	int getThreadCount() const { return (int)workers.size() + 1; }	// workers and the caller
+};
+
+#endif
@@ -0,0 +1,370 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ Terrain Tile Cache Class
+//
+//  Out-of-core terrain tiles with an LRU cache: 'TileCache.h'
+//
+//	##########################################################
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include "TileCache.h"
+#include "HeightMap.h"
+
+using namespace std;
+
+#ifdef WIN32
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+// every open() gets a new ID so that stale per-thread tiles are never reused
+static atomic<int> nextInstanceID(0);
+
+TileCache::TileCache()
+{
+	file = NULL;
+	dataStart = 0;
+	tileSize = tileMask = 0;
+	tileBytes = 0;
+	maxTiles = 0;
+	instanceID = -1;
+	stopLoader = false;
+	hits = misses = loads = evictions = 0;
+}
+
+TileCache::~TileCache()
+{
+	close();
+}
+
+bool TileCache::readHeader(const char *filename, TILEFILEHEADER &fileHeader)
+{
+	FILE *f = fopen(filename, "rb");
+	if (f == NULL) return false;
+
+	bool ok = (fread(&fileHeader, sizeof(TILEFILEHEADER), 1, f) == 1)
+						&& (fileHeader.magic == TILEFILE_MAGIC) && (fileHeader.version == TILEFILE_VERSION);
+	fclose(f);
+
+	return ok;
+}
+
+// split a heightmap into quantized tiles of (1 << tileShift) samples square
+bool TileCache::writeTiles(const HeightMap &source, int tileShift, float cellSpacing, float verticalScale, const char *filename)
+{
+	cout<<">> TileCache: writing "<<filename<<endl;
+
+	FILE *f = fopen(filename, "wb");
+	if (f == NULL)
+	{
+		cout<<">> TileCache: could not create "<<filename<<endl;
+		return false;
+	}
+
+	int size = 1 << tileShift;
+
+	TILEFILEHEADER fileHeader;
+	fileHeader.magic = TILEFILE_MAGIC;
+	fileHeader.version = TILEFILE_VERSION;
+	fileHeader.width = source.getWidth();
+	fileHeader.length = source.getLength();
+	fileHeader.tileShift = tileShift;
+	fileHeader.tilesX = (fileHeader.width + size - 1) / size;
+	fileHeader.tilesZ = (fileHeader.length + size - 1) / size;
+	fileHeader.cellSpacing = cellSpacing;
+	fileHeader.verticalScale = verticalScale;
+
+	// first pass: the height range of each tile
+	vector<TILEINFO> infos(fileHeader.tilesX * fileHeader.tilesZ);
+	for (int tx = 0; tx < fileHeader.tilesX; tx++)
+	{
+		for (int tz = 0; tz < fileHeader.tilesZ; tz++)
+		{
+			int x1 = min((tx + 1) * size, fileHeader.width);
+			int z1 = min((tz + 1) * size, fileHeader.length);
+
+			float lo = source.getSample(tx * size, tz * size);
+			float hi = lo;
+			for (int x = tx * size; x < x1; x++)
+			{
+				for (int z = tz * size; z < z1; z++)
+				{
+					float value = source.getSample(x, z);
+					lo = min(lo, value);
+					hi = max(hi, value);
+				}
+			}
+
+			infos[tx * fileHeader.tilesZ + tz].offset = lo;
+			infos[tx * fileHeader.tilesZ + tz].scale = (hi - lo) / 65535.0f;
+		}
+	}
+
+	fwrite(&fileHeader, sizeof(TILEFILEHEADER), 1, f);
+	fwrite(&infos[0], sizeof(TILEINFO), infos.size(), f);
+
+	// second pass: quantize, samples outside the heightmap repeat the edge
+	vector<uint16_t> samples(size * size);
+	for (int tx = 0; tx < fileHeader.tilesX; tx++)
+	{
+		for (int tz = 0; tz < fileHeader.tilesZ; tz++)
+		{
+			const TILEINFO &info = infos[tx * fileHeader.tilesZ + tz];
+
+			for (int x = 0; x < size; x++)
+			{
+				for (int z = 0; z < size; z++)
+				{
+					int sx = min(tx * size + x, fileHeader.width - 1);
+					int sz = min(tz * size + z, fileHeader.length - 1);
+					float value = source.getSample(sx, sz);
+					samples[x * size + z] = (info.scale > 0.0f) ? (uint16_t)((value - info.offset) / info.scale + 0.5f) : 0;
+				}
+			}
+
+			fwrite(&samples[0], sizeof(uint16_t), samples.size(), f);
+		}
+	}
+
+	bool ok = (ferror(f) == 0);
+	fclose(f);
+
+	cout<<">> TileCache: "<<fileHeader.tilesX<<"x"<<fileHeader.tilesZ<<" tiles of "<<size<<"x"<<size<<" written"<<endl;
+	return ok;
+}
+
+bool TileCache::open(const char *filename, size_t memoryBudget)
+{
+	close();
+
+	file = fopen(filename, "rb");
+	if (file == NULL)
+	{
+		cout<<">> TileCache: could not open "<<filename<<endl;
+		return false;
+	}
+
+	if ((fread(&header, sizeof(TILEFILEHEADER), 1, file) != 1)
+			|| (header.magic != TILEFILE_MAGIC) || (header.version != TILEFILE_VERSION))
+	{
+		cout<<">> TileCache: "<<filename<<" is not a tile file"<<endl;
+		fclose(file);
+		file = NULL;
+		return false;
+	}
+
+	tileInfo.resize(header.tilesX * header.tilesZ);
+	if (fread(&tileInfo[0], sizeof(TILEINFO), tileInfo.size(), file) != tileInfo.size())
+	{
+		cout<<">> TileCache: "<<filename<<" is truncated"<<endl;
+		fclose(file);
+		file = NULL;
+		return false;
+	}
+
+	dataStart = sizeof(TILEFILEHEADER) + sizeof(TILEINFO) * tileInfo.size();
+	tileSize = 1 << header.tileShift;
+	tileMask = tileSize - 1;
+	tileBytes = sizeof(uint16_t) * tileSize * tileSize;
+	instanceID = nextInstanceID++;
+	setMemoryBudget(memoryBudget);
+
+	cout<<">> TileCache: "<<filename<<" "<<header.width<<"x"<<header.length<<" in "
+			<<header.tilesX<<"x"<<header.tilesZ<<" tiles, budget "<<maxTiles<<" tiles"<<endl;
+
+	// start the background loader
+	stopLoader = false;
+	loader = thread(&TileCache::loaderLoop, this);
+
+	return true;
+}
+
+void TileCache::close()
+{
+	if (file == NULL) return;
+
+	// stop the background loader
+	{
+		lock_guard<mutex> guard(cacheLock);
+		stopLoader = true;
+	}
+	wakeLoader.notify_all();
+	if (loader.joinable()) loader.join();
+
+	fclose(file);
+	file = NULL;
+
+	resident.clear();
+	lru.clear();
+	requests.clear();
+	pending.clear();
+	tileInfo.clear();
+	instanceID = -1;
+}
+
+void TileCache::setMemoryBudget(size_t bytes)
+{
+	lock_guard<mutex> guard(cacheLock);
+
+	// always keep a few tiles so that neighbouring samples can be read
+	maxTiles = max((size_t)4, bytes / tileBytes);
+
+	while (resident.size() > maxTiles)
+	{
+		resident.erase(lru.back());
+		lru.pop_back();
+		evictions++;
+	}
+}
+
+// read one tile from disk (no cache lock held)
+shared_ptr<TERRAINTILE> TileCache::readTile(int key)
+{
+	shared_ptr<TERRAINTILE> tile(new TERRAINTILE);
+	tile->key = key;
+	tile->info = tileInfo[key];
+	tile->samples.resize(tileSize * tileSize);
+
+	lock_guard<mutex> guard(fileLock);
+	fseek64(file, dataStart + (long long)key * tileBytes, SEEK_SET);
+	if (fread(&tile->samples[0], 1, tileBytes, file) != tileBytes)
+		cout<<">> TileCache: could not read tile "<<key<<endl;
+
+	return tile;
+}
+
+// add a tile to the cache (cache lock held), evicting the least recently used
+void TileCache::insert(const shared_ptr<TERRAINTILE> &tile)
+{
+	lru.push_front(tile->key);
+
+	CACHEENTRY entry;
+	entry.tile = tile;
+	entry.lruPos = lru.begin();
+	resident[tile->key] = entry;
+	loads++;
+
+	while (resident.size() > maxTiles)
+	{
+		resident.erase(lru.back());
+		lru.pop_back();
+		evictions++;
+	}
+}
+
+// the tile for key, read synchronously when it is not resident
+shared_ptr<TERRAINTILE> TileCache::acquire(int key)
+{
+	{
+		lock_guard<mutex> guard(cacheLock);
+		map<int, CACHEENTRY>::iterator it = resident.find(key);
+		if (it != resident.end())
+		{
+			lru.splice(lru.begin(), lru, it->second.lruPos);		// most recently used
+			hits++;
+			return it->second.tile;
+		}
+		misses++;
+	}
+
+	shared_ptr<TERRAINTILE> tile = readTile(key);
+
+	lock_guard<mutex> guard(cacheLock);
+	map<int, CACHEENTRY>::iterator it = resident.find(key);
+	if (it != resident.end())		// the loader got there first
+		return it->second.tile;
+
+	insert(tile);
+	return tile;
+}
+
+void TileCache::prefetch(const vector<int> &keys)
+{
+	bool queued = false;
+	{
+		lock_guard<mutex> guard(cacheLock);
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			map<int, CACHEENTRY>::iterator it = resident.find(keys[i]);
+			if (it != resident.end())
+				lru.splice(lru.begin(), lru, it->second.lruPos);	// still in use, keep it
+			else if (pending.insert(keys[i]).second)
+			{
+				requests.push_back(keys[i]);
+				queued = true;
+			}
+		}
+	}
+
+	if (queued) wakeLoader.notify_one();
+}
+
+void TileCache::loaderLoop()
+{
+	while (true)
+	{
+		int key;
+		{
+			unique_lock<mutex> guard(cacheLock);
+			while (!stopLoader && requests.empty())
+				wakeLoader.wait(guard);
+
+			if (stopLoader) return;
+
+			key = requests.front();
+			requests.pop_front();
+
+			if (resident.find(key) != resident.end())
+			{
+				pending.erase(key);
+				continue;
+			}
+		}
+
+		shared_ptr<TERRAINTILE> tile = readTile(key);
+
+		lock_guard<mutex> guard(cacheLock);
+		pending.erase(key);
+		if (resident.find(key) == resident.end())
+			insert(tile);
+	}
+}
+
+// each tile is quantized over its own range, so offset is its lowest sample and
+// offset + 65535 * scale its highest
+void TileCache::getSampleRange(int x0, int z0, int x1, int z1, float &lo, float &hi) const
+{
+	lo = hi = 0.0f;
+	bool first = true;
+
+	for (int tx = x0 >> header.tileShift; tx <= (x1 >> header.tileShift); tx++)
+	{
+		for (int tz = z0 >> header.tileShift; tz <= (z1 >> header.tileShift); tz++)
+		{
+			const TILEINFO &info = tileInfo[tx * header.tilesZ + tz];
+			float tileHi = info.offset + 65535.0f * info.scale;
+			lo = first ? info.offset : min(lo, info.offset);
+			hi = first ? tileHi : max(hi, tileHi);
+			first = false;
+		}
+	}
+}
+
+size_t TileCache::getResidentBytes()
+{
+	lock_guard<mutex> guard(cacheLock);
+	return resident.size() * tileBytes;
+}
+
+void TileCache::reportStats()
+{
+	lock_guard<mutex> guard(cacheLock);
+	cout<<">> TileCache: "<<resident.size()<<"/"<<maxTiles<<" tiles resident ("<<resident.size() * tileBytes<<" bytes)"
+			<<" | hits:"<<hits<<" misses:"<<misses<<" loads:"<<loads<<" evictions:"<<evictions
+			<<" queued:"<<requests.size()<<endl;
+}
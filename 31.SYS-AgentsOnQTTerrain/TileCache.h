@@ -0,0 +1,153 @@
+//	##########################################################
+//	By Eugene Ch'ng | www.complexity.io | 2018
+//	Email: genechng@gmail.com
+//	----------------------------------------------------------
+//	A C++ Terrain Tile Cache Class
+//
+//  Out-of-core terrain: the heightfield is split into fixed-size
+//  tiles on disk (a .tiles file) and only the tiles in use are
+//  kept in memory, in a least-recently-used cache bounded by a
+//  memory budget. Tiles are read on demand by getSample() or in
+//  the background by a loader thread after prefetch()
+//
+//  .tiles file layout
+//    TILEFILEHEADER
+//    TILEINFO[tilesX * tilesZ]		per tile offset and scale
+//    uint16_t[tileSize * tileSize] per tile, row by row, in tile order
+//
+//	##########################################################
+
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <list>
+#include <deque>
+#include <set>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+#define TILEFILE_MAGIC			0x4C545451		// 'QTTL'
+#define TILEFILE_VERSION		1
+#define TILECACHE_DEFAULT_BUDGET	(64 * 1024 * 1024)	// bytes
+
+class HeightMap;
+
+struct TILEFILEHEADER
+{
+	uint32_t magic;
+	uint32_t version;
+	int32_t width, length;		// number of samples along x and z
+	int32_t tileShift;				// tiles are (1 << tileShift) samples square
+	int32_t tilesX, tilesZ;		// number of tiles along x and z
+	float cellSpacing;				// distance between samples in OpenGL units
+	float verticalScale;			// world height of a sample of 1.0
+};
+
+// dequantization of a tile: sample = offset + value * scale
+struct TILEINFO
+{
+	float offset;
+	float scale;
+};
+
+struct TERRAINTILE
+{
+	int key;									// tileX * tilesZ + tileZ
+	TILEINFO info;
+	std::vector<uint16_t> samples;
+};
+
+class TileCache
+{
+private:
+	FILE *file;										// the open .tiles file
+	TILEFILEHEADER header;
+	std::vector<TILEINFO> tileInfo;	// read once at open
+	long long dataStart;					// file offset of the first tile
+	int tileSize, tileMask;
+	size_t tileBytes;							// bytes of one resident tile
+	size_t maxTiles;							// the memory budget in tiles
+	int instanceID;								// identifies this cache in the per-thread last tile
+
+	// resident tiles, most recently used at the front of lru
+	struct CACHEENTRY
+	{
+		std::shared_ptr<TERRAINTILE> tile;
+		std::list<int>::iterator lruPos;
+	};
+	std::map<int, CACHEENTRY> resident;
+	std::list<int> lru;
+
+	// background loader
+	std::deque<int> requests;
+	std::set<int> pending;
+	std::thread loader;
+	bool stopLoader;
+
+	std::mutex cacheLock;					// guards resident, lru, requests, pending, stats
+	std::mutex fileLock;					// guards the file position
+	std::condition_variable wakeLoader;
+
+	// statistics
+	unsigned long hits, misses, loads, evictions;
+
+	// a cache owns a file and a thread, copying is not allowed
+	TileCache(const TileCache &);
+	TileCache &operator=(const TileCache &);
+
+	std::shared_ptr<TERRAINTILE> readTile(int key);
+	std::shared_ptr<TERRAINTILE> acquire(int key);
+	void insert(const std::shared_ptr<TERRAINTILE> &tile);
+	void loaderLoop();
+
+public:
+	TileCache();
+	~TileCache();
+
+	static bool readHeader(const char *filename, TILEFILEHEADER &fileHeader);
+	static bool writeTiles(const HeightMap &source, int tileShift, float cellSpacing, float verticalScale, const char *filename);
+
+	bool open(const char *filename, size_t memoryBudget = TILECACHE_DEFAULT_BUDGET);
+	void close();
+	void setMemoryBudget(size_t bytes);
+
+	// the sample at [x][z] (0..1 for 16-bit sources), loading its tile if needed
+	float getSample(int x, int z)
+	{
+		struct LASTTILE { int owner; int key; std::shared_ptr<TERRAINTILE> tile; };
+		static thread_local LASTTILE last = { -1, -1, std::shared_ptr<TERRAINTILE>() };
+
+		int key = (x >> header.tileShift) * header.tilesZ + (z >> header.tileShift);
+		if ((last.owner != instanceID) || (last.key != key))
+		{
+			last.tile = acquire(key);
+			last.owner = instanceID;
+			last.key = key;
+		}
+
+		const TERRAINTILE *t = last.tile.get();
+		return t->info.offset + t->samples[((x & tileMask) << header.tileShift) + (z & tileMask)] * t->info.scale;
+	}
+
+	// the tile holding sample [x][z]
+	int tileKey(int x, int z) const { return (x >> header.tileShift) * header.tilesZ + (z >> header.tileShift); }
+
+	// the sample range of the tiles holding the samples [x0, x1] x [z0, z1], from the tile index (no tile is read)
+	void getSampleRange(int x0, int z0, int x1, int z1, float &lo, float &hi) const;
+
+	void prefetch(const std::vector<int> &keys);	// queue tiles for the background loader
+	void reportStats();
+
+	bool isOpen() const { return file != NULL; }
+	int getWidth() const { return header.width; }
+	int getLength() const { return header.length; }
+	size_t getResidentBytes();
+};
+
+#endif
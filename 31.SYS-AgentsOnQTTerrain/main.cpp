@@ -11,7 +11,7 @@
 //  How to compile:
 //  note that we are now using both SDL2 and OpenGL, thus the -l for all libraries
 //  we are also using multiple cpp files
-//  sudo g++ -I/usr/include/ main.cpp Camera.cpp TerrainQuadTree.cpp QTTerrain.cpp Agent.cpp Predator.cpp Prey.cpp Snack.cpp Grid.cpp -o main -L/usr/lib -lSDL2 -lGL -lGLU
+//  sudo g++ -I/usr/include/ main.cpp Camera.cpp TerrainQuadTree.cpp QTTerrain.cpp HeightMap.cpp MappedFile.cpp TileCache.cpp TerrainCache.cpp ThreadPool.cpp NormalKernel.cpp HeightKernel.cpp TerrainNoise.cpp Agent.cpp Predator.cpp Prey.cpp Snack.cpp Grid.cpp -o main -L/usr/lib -lSDL2 -lGL -lGLU -pthread
 //
 // -I define the path to the includes folder
 // -L define the path to the library folder
@@ -24,11 +24,17 @@
 //  s and x to pitch up and down
 //  w and e to set wireframe mode and switch on/off mesh edges
 //  + and - to set quadtree view range
+//  p to cast a ray along the view direction and report where it hits the terrain
+//  c to switch on/off culling the terrain to the view frustum (r reports the culled nodes)
 //  i,j,k,l to move the agent - MoveableOnQTTerrain.h
 //	##########################################################
 
 #include <iostream>
 #include <string>
+#include <string.h>
+#include <stdlib.h>
+#include <future>
+#include <chrono>
 #include "OGLUtil.h"
 #include "Grid.h"
 #include "Camera.h"
@@ -87,25 +93,67 @@ int main(int argc, char**argv)
     cout<<"*********************** Initialising Scene Utility ***********************"<<endl;
 
     cout<<"*********************** Create a Terrain ***********************"<<endl;
-    char heightMapFile[] = "terr512.raw";
-    unsigned int terrainWidth = 512;
-    unsigned int terrainLength = 512;
-    float terrainHeightScale = 30.0f;
-    float terrain_Scale = 15.0f;
-    terrain = new QTTerrain(heightMapFile, terrainWidth, terrainLength, terrainHeightScale, terrain_Scale, NORMAL_SMOOTH);
+    // the size, cell spacing and height scale are read from terr512.hdr
+    // another heightmap can be given on the command line, a .tiles file is streamed
+    //   ./main terrain.tiles
+    //   ./main -tiles terr512.raw terr512.tiles    (split a heightmap into tiles)
+    //   ./main -fbm 4096 7                         (a generated 4096x4096 terrain, seed 7)
+    char defaultHeightMap[] = "terr512.raw";
+    char *heightMapFile = defaultHeightMap;
+    if ((argc == 4) && (strcmp(argv[1], "-tiles") == 0))
+    {
+      HEIGHTMAPINFO info;
+      HeightMap source;
+      if (!HeightMap::readHeader(argv[2], info) || !source.load(argv[2], info))
+        return 1;
+      return TileCache::writeTiles(source, HEIGHTMAP_TILE_SHIFT, info.cellSpacing, info.verticalScale, argv[3]) ? 0 : 1;
+    }
+
+    // the terrain heights, normals and quadtree are built on a worker thread while the camera,
+    // grid, agents, window and OpenGL context are set up, its size is known beforehand from the
+    // header (or the noise); SDL and the texture stay on this thread
+    chrono::steady_clock::time_point startupBegin = chrono::steady_clock::now();
+    HEIGHTMAPINFO terrainInfo;
+    future<QTTerrain*> terrainBuild;
+    if ((argc == 4) && (strcmp(argv[1], "-fbm") == 0))
+    {
+      // any size works, the quadtree depth follows from it (QTTerrain::quadTreeLevels)
+      HEIGHTMAPNOISE noise;
+      noise.width = noise.length = atoi(argv[2]);
+      noise.seed = (uint32_t)atoi(argv[3]);
+      noise.octaves = 8;
+      noise.featureSize = noise.width / 4.0f;
+      noise.persistence = 0.5f;
+      noise.cellSpacing = 15.0f;
+      noise.verticalScale = 1500.0f;
+
+      terrainInfo.width = noise.width;
+      terrainInfo.length = noise.length;
+      terrainInfo.cellSpacing = noise.cellSpacing;
+      terrainBuild = async(launch::async, [noise]() { return new QTTerrain(noise, NORMAL_CENTRAL, NORMALS_OCT16); });
+    }
+    else
+    {
+      if (argc > 1)
+        heightMapFile = argv[1];
+
+      // without a size there is no terrain to build
+      if (!HeightMap::readHeader(heightMapFile, terrainInfo))
+      {
+        cout<<"Unable to read the heightmap header: "<<heightMapFile<<endl;
+        return 1;
+      }
+      terrainBuild = async(launch::async, [heightMapFile]() { return new QTTerrain(heightMapFile, NORMAL_CENTRAL, NORMALS_OCT16, HEIGHTS_FROM_PLANES); });
+    }
+    float terrain_Scale = terrainInfo.cellSpacing;
 
     cout<<"*********************** Create a Camera ***********************"<<endl;
     camera = new Camera(Vector3f(0, 30.0f, 100.0f), Vector3f(0.0f, 0.0f, -1.0f), 0.5f, 3.0f, 20.0f);
 
-    // set camera on top of terrain
-    float cameraEyeHeight = terrain->getHeight(camera->getPosition()) + 30.0f;
-    cout<<"Camera Eye Height: "<<cameraEyeHeight<<endl;
-    camera->setEyeHeight(cameraEyeHeight);
-
     cout<<"*********************** Create a Grid ***********************"<<endl;
     //  instantiate grid
-    float gridWidth = 512.0f;
-    float gridLength = 512.0f;
+    float gridWidth = terrainInfo.width;
+    float gridLength = terrainInfo.length;
     float gridSpacing = 16.0f;
     grid = new Grid(gridWidth*terrain_Scale, gridLength*terrain_Scale, gridSpacing);
 
@@ -203,8 +251,6 @@ int main(int argc, char**argv)
       agents[i]->getGrid(grid);
       // cout<<"Agents"<<i<<endl;
       agents[i]->getAgents(agents, agentNo);
-      // cout<<"terrain"<<i<<endl;
-      agents[i]->getTerrain(terrain);
     }
 
     cout<<"*********************** Begin SDL OpenGL ***********************"<<endl;
@@ -243,6 +289,22 @@ int main(int argc, char**argv)
     // setup viewport
     setViewport(1024, 786);
 
+    cout<<"*********************** Wait for the Terrain ***********************"<<endl;
+    chrono::steady_clock::time_point waitBegin = chrono::steady_clock::now();
+    terrain = terrainBuild.get();
+    double terrainWaitMs = chrono::duration<double, milli>(chrono::steady_clock::now() - waitBegin).count();
+
+    // SDL and the GL context exist now, the texture is loaded on this thread
+    terrain->uploadTextures();
+
+    // set camera on top of terrain
+    float cameraEyeHeight = terrain->getHeight(camera->getPosition()) + 30.0f;
+    cout<<"Camera Eye Height: "<<cameraEyeHeight<<endl;
+    camera->setEyeHeight(cameraEyeHeight);
+
+    for(int i=0; i<agentNo; i++)
+      agents[i]->getTerrain(terrain);
+
     // --------------------- SIMULATION BLOCK
     cout<<"------- SIMULATION BLOCK STARTED"<<endl;
     // Simulation main loop is defined here
@@ -252,6 +314,7 @@ int main(int argc, char**argv)
     int frameRate = 1000 / 60;
     Uint32 timeStart = SDL_GetTicks();
     float px = 0.0f;
+    bool firstFrame = true;
     while (isRunning) {
         checkKeyPress();
 
@@ -275,20 +338,39 @@ int main(int argc, char**argv)
           // couple all of them together
           glPushMatrix();
             grid->render();
-            terrain->render(camera->getPosition());
+            float viewProjection[16];
+            camera->getViewProjection(viewProjection);
+            terrain->render(camera->getPosition(), viewProjection);
+
+            // per-frame terrain state (line of sight answers) before the agents use it
+            terrain->update();
 
             // agents update
             for(int i=0; i<agentNo; i++)
             {
               // cout<<"agent "<<i<<endl;
               agents[i]->update();
-              agents[i]->render();
             }
+
+            // one terrain height query per species
+            Agent::placeAgentsOnTerrain(agents, noPred, terrain);
+            Agent::placeAgentsOnTerrain(agents + noPred, noPrey, terrain);
+            Agent::placeAgentsOnTerrain(agents + noPred + noPrey, noSnack, terrain);
+
+            for(int i=0; i<agentNo; i++)
+              agents[i]->render();
           glPopMatrix();
 
           // Update window with OpenGL rendering
           SDL_GL_SwapWindow(displayWindow);
 
+          if (firstFrame)
+          {
+            firstFrame = false;
+            double firstFrameMs = chrono::duration<double, milli>(chrono::steady_clock::now() - startupBegin).count();
+            cout<<">> Time to first frame: "<<firstFrameMs<<" ms (waited "<<terrainWaitMs<<" ms for the terrain)"<<endl;
+          }
+
           // ------------------ END ALL UPDATES AND RENDERING HERE
         }
     }
@@ -429,6 +511,10 @@ void checkKeyPress()
         {
           terrain->setEdgeMode();
         }
+        if ( event.key.keysym.sym == SDLK_c )
+        {
+          terrain->setFrustumCulling();
+        }
 
         // ---------------------------------------------------------------- INFO
          if ( event.key.keysym.sym == SDLK_h )
@@ -439,6 +525,22 @@ void checkKeyPress()
         {
   				terrain->terrainQT->reportNodeBranchIndex();
   				camera->print();
+  				terrain->reportTileCache();
+        }
+        if ( event.key.keysym.sym == SDLK_n )
+        {
+  				terrain->compareNormals();
+        }
+        if ( event.key.keysym.sym == SDLK_p )
+        {
+  				RAYHIT hit;
+  				Vector3f eye = camera->getPosition();
+  				Vector3f view(camera->tx - camera->x, camera->ty - camera->y, camera->tz - camera->z);
+  				if (terrain->rayCast(eye, view, 100000.0f, hit))
+  					cout<<">> Ray hit cell ["<<hit.cellX<<"]["<<hit.cellZ<<"] at "<<hit.point.x<<" "<<hit.point.y<<" "<<hit.point.z
+  							<<" ("<<hit.distance<<" away)"<<endl;
+  				else
+  					cout<<">> Ray does not hit the terrain"<<endl;
         }
 
         // ---------------------------------------------------------------- TERRAIN VIEWING RANGE
@@ -504,6 +606,7 @@ int setViewport( int width, int height )
     // gluPerspective(	GLdouble fovy, GLdouble aspect, GLdouble zNear, GLdouble zFar);
     //gluPerspective(45.0f, ratio, 0.1f, 100.0f);
     gluPerspective(45.0f, (GLfloat)width/(GLfloat)height, 0.1f, 5000.0f);    // Calculate The Aspect Ratio Of The Window
+    camera->setPerspective(45.0f, (GLfloat)width/(GLfloat)height, 0.1f, 5000.0f);   // the same for culling the terrain
 
     // use glu function to set a camera looking at
     // void gluLookAt(	GLdouble eyeX, GLdouble eyeY, GLdouble eyeZ,
@@ -515,7 +618,8 @@ int setViewport( int width, int height )
     // up vector is Y
 
     // gluLookAt(0.0f, 80.0f, 0.0f, 0.0f, -20.0f, -0.01f, 0.0f, 1.0f, 0.0f);
-    gluLookAt(camera->x, camera->y, camera->z, camera->tx, camera->ty, camera->tz, 0.0f, 1.0f, 0.0f);
+    // the camera's gluLookAt is applied to the MODELVIEW every frame (see the main loop),
+    // the projection holds the perspective only so that it matches Camera::getViewProjection
 
     // now switch to the MODELVIEW MATRIX so that we can control (transform)
     // everything we draw (rectangles, etc.)